@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+
+# CA bundle generator for Pico HTTPS example ###################################
+#                                                                              #
+#   Converts a PEM CA bundle (concatenated certificates) into a C header       #
+#   defining the certificates as a single DER blob, and an index into it       #
+#   sorted by subject name hash. Both are compiled into the program image as   #
+#   constant data, so remain in flash (XIP); see PICOHTTPS_CA_BUNDLE.          #
+#                                                                              #
+#   Usage: ca_bundle.py <bundle.pem> <ca_bundle.h>                             #
+#                                                                              #
+################################################################################
+
+import base64
+import re
+import sys
+
+
+# Subject name hash
+#
+#   FNV-1a (32-bit) over the DER-encoded name, tag and length included. Must
+#   match ca_bundle_hash() in picohttps.c.
+#
+def name_hash(name):
+    hash = 0x811c9dc5
+    for byte in name:
+        hash ^= byte
+        hash = (hash * 0x01000193) & 0xffffffff
+    return hash
+
+
+# DER tag-length-value header
+#
+#   Returns the offset of the value, and its length.
+#
+def der_header(der, offset):
+    length = der[offset + 1]
+    offset += 2
+    if length & 0x80:
+        count = length & 0x7f
+        length = int.from_bytes(der[offset:offset + count], "big")
+        offset += count
+    return offset, length
+
+
+# Subject name
+#
+#   Located within the TBSCertificate; after the (optional) version, serial
+#   number, signature algorithm, issuer and validity.
+#
+#   Returns the offset and length of the name, tag and length included.
+#
+def subject(der):
+    offset, _ = der_header(der, 0)              # Certificate
+    offset, _ = der_header(der, offset)         # TBSCertificate
+    if der[offset] == 0xa0:                     # Version
+        value, length = der_header(der, offset)
+        offset = value + length
+    for _ in range(4):                          # Serial … validity
+        value, length = der_header(der, offset)
+        offset = value + length
+    value, length = der_header(der, offset)
+    return offset, value + length - offset
+
+
+# Parse bundle
+pem = open(sys.argv[1]).read()
+certs = [
+    base64.b64decode(body)
+    for body in re.findall(
+        r"-----BEGIN CERTIFICATE-----(.*?)-----END CERTIFICATE-----",
+        pem,
+        re.DOTALL
+    )
+]
+if not certs:
+    sys.exit("No certificates in " + sys.argv[1])
+
+# Build blob and index
+blob = bytearray()
+index = []
+for der in certs:
+    if len(der) > 0xffff:
+        sys.exit("Certificate too large")
+    subject_offset, subject_len = subject(der)
+    index.append((
+        name_hash(der[subject_offset:subject_offset + subject_len]),
+        len(blob),
+        len(der),
+        subject_offset,
+        subject_len
+    ))
+    blob += der
+index.sort()
+
+# Write header
+with open(sys.argv[2], "w") as header:
+    header.write(
+        "// Generated by ca_bundle.py from " + sys.argv[1] + "; do not edit\n"
+        "//\n"
+        "// " + str(len(certs)) + " certificates, " + str(len(blob)) + " bytes\n"
+        "\n"
+        "#define PICOHTTPS_CA_BUNDLE_DER \\\n"
+        "{ \\\n"
+    )
+    for i in range(0, len(blob), 16):
+        header.write(
+            "    " + ", ".join(
+                "0x%02x" % byte for byte in blob[i:i + 16]
+            ) + ", \\\n"
+        )
+    header.write(
+        "}\n"
+        "\n"
+        "#define PICOHTTPS_CA_BUNDLE_INDEX \\\n"
+        "{ \\\n"
+    )
+    for entry in index:
+        header.write("    { 0x%08x, %u, %u, %u, %u }, \\\n" % entry)
+    header.write("}\n")
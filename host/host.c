@@ -0,0 +1,191 @@
+/* Host support for Pico HTTPS example ****************************************
+ *                                                                            *
+ *  Definitions common to the host executables (recv_bench.c, soak.c): heap   *
+ *  accounting, clock, random numbers, lwIP lock and statistics, and the      *
+ *  Pico SDK, lwIP and Mbed TLS functions the receive path depends on (see    *
+ *  host.h).                                                                  *
+ *                                                                            *
+ ******************************************************************************/
+
+
+/* Includes *******************************************************************/
+
+#include <malloc.h>                 // malloc_usable_size
+
+#include "host.h"                   // Pico SDK, lwIP, Mbed TLS stand-ins
+#include "picohttps.h"              // Options, macros, forward declarations
+
+
+/* Globals ********************************************************************/
+
+// Heap allocations
+u32_t host_allocations;
+u32_t host_heap_count;
+size_t host_heap_used;
+
+// lwIP statistics
+static struct stats_mem memp_stats[MEMP_MAX];
+struct stats_ lwip_stats;
+
+
+/* Functions ******************************************************************/
+
+// Initialise host support
+void host_init(void){
+    for(size_t i = 0; i < LEN(memp_stats); i++)
+        lwip_stats.memp[i] = &memp_stats[i];
+}
+
+// Count heap allocations
+//
+//  Executables are linked with allocator calls wrapped (--wrap); those made
+//  by the C library itself (e.g. stdio) are not counted.
+//
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+void* __wrap_malloc(size_t size){
+    void* ptr = __real_malloc(size);
+    if(ptr){
+        host_allocations++;
+        host_heap_count++;
+        host_heap_used += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+void* __wrap_calloc(size_t n, size_t size){
+    void* ptr = __real_calloc(n, size);
+    if(ptr){
+        host_allocations++;
+        host_heap_count++;
+        host_heap_used += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+void* __wrap_realloc(void* ptr, size_t size){
+    size_t used = ptr ? malloc_usable_size(ptr) : 0;
+    void* moved = __real_realloc(ptr, size);
+    if(moved || !size){
+        host_allocations++;
+        host_heap_count += !ptr - !moved;
+        host_heap_used += (moved ? malloc_usable_size(moved) : 0) - used;
+    }
+    return moved;
+}
+void __wrap_free(void* ptr){
+    if(ptr){
+        host_heap_count--;
+        host_heap_used -= malloc_usable_size(ptr);
+    }
+    __real_free(ptr);
+}
+
+// Time
+//
+//  Monotonic clock, from first use.
+//
+uint64_t time_us_64(void){
+    static uint64_t epoch;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t us = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    if(!epoch) epoch = us - 1;
+    return us - epoch;
+}
+uint32_t time_us_32(void){
+    return (uint32_t)time_us_64();
+}
+absolute_time_t get_absolute_time(void){
+    return time_us_64();
+}
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to){
+    return (int64_t)(to - from);
+}
+bool is_nil_time(absolute_time_t t){
+    return t == nil_time;
+}
+bool time_reached(absolute_time_t t){
+    return get_absolute_time() >= t;
+}
+
+// Random numbers
+uint32_t get_rand_32(void){
+    return (uint32_t)rand();
+}
+
+// lwIP lock
+//
+//  Single threaded; nothing to lock out.
+//
+void cyw43_arch_lwip_begin(void){}
+void cyw43_arch_lwip_end(void){}
+
+// Copy from packet buffer chain
+u16_t pbuf_copy_partial(
+    const struct pbuf* p,
+    void* dataptr,
+    u16_t len,
+    u16_t offset
+){
+    u16_t copied = 0;
+    for(; p && copied < len; p = p->next){
+        if(offset >= p->len){
+            offset -= p->len;
+            continue;
+        }
+        u16_t n = LWIP_MIN(p->len - offset, len - copied);
+        memcpy((u8_t*)dataptr + copied, (const u8_t*)p->payload + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+// Write to connection
+//
+//  Never connected (e.g. WebSocket frames answering traced pings); discarded.
+//
+err_t altcp_write(
+    struct altcp_pcb* conn,
+    const void* dataptr,
+    u16_t len,
+    u8_t apiflags
+){
+    return ERR_OK;
+}
+err_t altcp_output(struct altcp_pcb* conn){
+    return ERR_OK;
+}
+
+// WebSocket handshake hashing
+//
+//  Not provided; traced handshakes are taken as invalid.
+//
+void mbedtls_sha1_init(mbedtls_sha1_context* ctx){}
+void mbedtls_sha1_free(mbedtls_sha1_context* ctx){}
+int mbedtls_sha1_starts_ret(mbedtls_sha1_context* ctx){
+    return -1;
+}
+int mbedtls_sha1_update_ret(
+    mbedtls_sha1_context* ctx,
+    const unsigned char* input,
+    size_t ilen
+){
+    return -1;
+}
+int mbedtls_sha1_finish_ret(
+    mbedtls_sha1_context* ctx,
+    unsigned char output[20]
+){
+    return -1;
+}
+int mbedtls_base64_encode(
+    unsigned char* dst,
+    size_t dlen,
+    size_t* olen,
+    const unsigned char* src,
+    size_t slen
+){
+    return -1;
+}
@@ -0,0 +1,608 @@
+/* Host shim for Pico HTTPS example *******************************************
+ *                                                                            *
+ *  Declarations standing in for the Pico SDK, lwIP and Mbed TLS interfaces   *
+ *  used by picohttps.c, so that it can be compiled for the host (see         *
+ *  CMakeLists.txt). Each SDK header picohttps.c includes is generated as a   *
+ *  forward to this one.                                                      *
+ *                                                                            *
+ *  Only the parts of picohttps.c an executable exercises are linked (the     *
+ *  receive path for recv_bench.c, the connection lifecycle for soak.c);      *
+ *  their dependencies are defined there and in host.c. Everything else is    *
+ *  discarded by the linker, and merely declared here. Types carry only the   *
+ *  members picohttps.c uses.                                                 *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef PICOHTTPS_HOST_H
+#define PICOHTTPS_HOST_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "lwipopts.h"
+#include "mbedtls_config.h"
+
+
+/* lwIP ***********************************************************************/
+
+// Architecture
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+#define LWIP_MIN(a, b)                              ((a) < (b) ? (a) : (b))
+#define LWIP_MAX(a, b)                              ((a) > (b) ? (a) : (b))
+#define LWIP_UNUSED_ARG(x)                          (void)(x)
+#define LWIP_ASSERT(message, assertion)             assert(assertion)
+#define lwip_htons(x)                               __builtin_bswap16(x)
+#define lwip_htonl(x)                               __builtin_bswap32(x)
+#define PP_HTONL(x)                                 __builtin_bswap32(x)
+
+// Errors
+typedef s8_t err_t;
+enum {
+    ERR_OK = 0, ERR_MEM = -1, ERR_BUF = -2, ERR_TIMEOUT = -3, ERR_RTE = -4,
+    ERR_INPROGRESS = -5, ERR_VAL = -6, ERR_WOULDBLOCK = -7, ERR_USE = -8,
+    ERR_ALREADY = -9, ERR_ISCONN = -10, ERR_CONN = -11, ERR_IF = -12,
+    ERR_ABRT = -13, ERR_RST = -14, ERR_CLSD = -15, ERR_ARG = -16
+};
+
+// IP addresses
+typedef struct ip4_addr { u32_t addr; } ip4_addr_t;
+typedef struct ip6_addr { u32_t addr[4]; u8_t zone; } ip6_addr_t;
+typedef struct ip_addr {
+    union { ip6_addr_t ip6; ip4_addr_t ip4; } u_addr;
+    u8_t type;
+} ip_addr_t;
+enum lwip_ip_addr_type {
+    IPADDR_TYPE_V4 = 0, IPADDR_TYPE_V6 = 6, IPADDR_TYPE_ANY = 46
+};
+#define IPADDR_STRLEN_MAX                           46
+#define IPADDR_NONE                                 ((u32_t)0xffffffffUL)
+#define IP_GET_TYPE(a)                              ((a)->type)
+#define IP_IS_V4(a)                                 ((a)->type == IPADDR_TYPE_V4)
+#define IP_IS_V6(a)                                 ((a)->type == IPADDR_TYPE_V6)
+#define ip_2_ip4(a)                                 (&((a)->u_addr.ip4))
+#define ip_2_ip6(a)                                 (&((a)->u_addr.ip6))
+#define ip_addr_copy(d, s)                          ((d) = (s))
+#define ip_addr_set_zero(a)                         memset((a), 0, sizeof(*(a)))
+#define ip_addr_cmp(a, b)                           !memcmp((a), (b), sizeof(*(a)))
+#define ip_addr_isany(a)                                                    \
+    (!(a) || !memcmp((a), &(ip_addr_t){ 0 }, sizeof(*(a))))
+#define ip_addr_set_ip4_u32(a, v)                                           \
+    do { ip_addr_set_zero(a); (a)->u_addr.ip4.addr = (v); } while(0)
+#define ip4_addr_get_u32(a)                         ((a)->addr)
+#define ip4_addr_set_u32(a, v)                      ((a)->addr = (v))
+#define ip4_addr_copy(d, s)                         ((d).addr = (s).addr)
+#define ip4_addr_cmp(a, b)                          ((a)->addr == (b)->addr)
+#define ip4_addr_isany(a)                           (!(a) || !(a)->addr)
+#define ip4_addr_isany_val(a)                       (!(a).addr)
+char* ipaddr_ntoa(const ip_addr_t* addr);
+char* ipaddr_ntoa_r(const ip_addr_t* addr, char* buf, int buflen);
+
+// Packet buffers
+//
+//  Defined (for the host) in recv_bench.c.
+//
+typedef enum { PBUF_TRANSPORT, PBUF_IP, PBUF_LINK, PBUF_RAW } pbuf_layer;
+typedef enum { PBUF_RAM, PBUF_ROM, PBUF_REF, PBUF_POOL } pbuf_type;
+struct pbuf {
+    struct pbuf* next;
+    void* payload;
+    u16_t tot_len;
+    u16_t len;
+    u16_t ref;
+};
+#define PBUF_POOL_BUFSIZE                           (TCP_MSS + 40 + 14)
+struct pbuf* pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+u8_t pbuf_free(struct pbuf* p);
+void pbuf_ref(struct pbuf* p);
+u16_t pbuf_copy_partial(
+    const struct pbuf* p,
+    void* dataptr,
+    u16_t len,
+    u16_t offset
+);
+
+// Network interfaces
+struct netif {
+    struct netif* next;
+    ip_addr_t ip_addr;
+    ip_addr_t netmask;
+    ip_addr_t gw;
+    u8_t flags;
+    u8_t hwaddr[6];
+};
+#define NETIF_FLAG_UP                               0x01
+#define NETIF_FLAG_LINK_UP                          0x04
+#define netif_is_up(n)                              (!!((n)->flags & NETIF_FLAG_UP))
+#define netif_is_link_up(n)                         (!!((n)->flags & NETIF_FLAG_LINK_UP))
+#define netif_ip4_addr(n)                           ip_2_ip4(&((n)->ip_addr))
+#define netif_ip4_netmask(n)                        ip_2_ip4(&((n)->netmask))
+#define netif_ip4_gw(n)                             ip_2_ip4(&((n)->gw))
+typedef void (*netif_status_callback_fn)(struct netif* netif);
+void netif_set_status_callback(
+    struct netif* netif,
+    netif_status_callback_fn fn
+);
+void netif_set_link_callback(struct netif* netif, netif_status_callback_fn fn);
+void netif_set_addr(
+    struct netif* netif,
+    const ip4_addr_t* ipaddr,
+    const ip4_addr_t* netmask,
+    const ip4_addr_t* gw
+);
+u32_t sys_now(void);
+
+// DNS, DHCP, ARP
+typedef void (*dns_found_callback)(
+    const char* name,
+    const ip_addr_t* ipaddr,
+    void* arg
+);
+#define LWIP_DNS_ADDRTYPE_IPV4                      0
+#define LWIP_DNS_ADDRTYPE_IPV6                      1
+err_t dns_gethostbyname_addrtype(
+    const char* hostname,
+    ip_addr_t* addr,
+    dns_found_callback found,
+    void* arg,
+    u8_t dns_addrtype
+);
+void dns_setserver(u8_t numdns, const ip_addr_t* dnsserver);
+const ip_addr_t* dns_getserver(u8_t numdns);
+typedef enum {
+    DHCP_STATE_OFF = 0, DHCP_STATE_REQUESTING = 1, DHCP_STATE_INIT = 2,
+    DHCP_STATE_REBOOTING = 3, DHCP_STATE_REBINDING = 4,
+    DHCP_STATE_RENEWING = 5, DHCP_STATE_SELECTING = 6,
+    DHCP_STATE_INFORMING = 7, DHCP_STATE_CHECKING = 8,
+    DHCP_STATE_PERMANENT = 9, DHCP_STATE_BOUND = 10
+} dhcp_state_enum_t;
+struct dhcp {
+    u8_t state;
+    ip4_addr_t offered_ip_addr;
+    ip4_addr_t offered_sn_mask;
+    ip4_addr_t offered_gw_addr;
+};
+struct dhcp* netif_dhcp_data(struct netif* netif);
+err_t dhcp_start(struct netif* netif);
+struct eth_addr { u8_t addr[6]; } __attribute__((packed));
+ssize_t etharp_find_addr(
+    struct netif* netif,
+    const ip4_addr_t* ipaddr,
+    struct eth_addr** eth_ret,
+    const ip4_addr_t** ip_ret
+);
+err_t etharp_add_static_entry(
+    const ip4_addr_t* ipaddr,
+    struct eth_addr* ethaddr
+);
+err_t etharp_remove_static_entry(const ip4_addr_t* ipaddr);
+
+// TCP
+enum tcp_state { CLOSED, LISTEN, SYN_SENT, SYN_RCVD, ESTABLISHED };
+struct tcp_pcb {
+    enum tcp_state state;
+    u8_t so_options;
+    u32_t keep_idle;
+    u32_t keep_intvl;
+    u32_t keep_cnt;
+    u16_t rcv_wnd;
+    u16_t rcv_ann_wnd;
+    u8_t nrtx;
+};
+#define SOF_KEEPALIVE                               0x08
+#define ip_set_option(pcb, opt)                     ((pcb)->so_options |= (opt))
+#define LWIP_IANA_PORT_HTTPS                        443
+
+// Application layered TCP (ALTCP) and TLS
+struct altcp_pcb;
+typedef err_t (*altcp_connected_fn)(
+    void* arg,
+    struct altcp_pcb* conn,
+    err_t err
+);
+typedef err_t (*altcp_recv_fn)(
+    void* arg,
+    struct altcp_pcb* conn,
+    struct pbuf* p,
+    err_t err
+);
+typedef err_t (*altcp_sent_fn)(void* arg, struct altcp_pcb* conn, u16_t len);
+typedef err_t (*altcp_poll_fn)(void* arg, struct altcp_pcb* conn);
+typedef void (*altcp_err_fn)(void* arg, err_t err);
+struct altcp_pcb {
+    struct altcp_pcb* inner_conn;
+    void* arg;
+    void* state;
+};
+#define TCP_WRITE_FLAG_COPY                         0x01
+#define TCP_WRITE_FLAG_MORE                         0x02
+void altcp_arg(struct altcp_pcb* conn, void* arg);
+void altcp_recv(struct altcp_pcb* conn, altcp_recv_fn recv);
+void altcp_sent(struct altcp_pcb* conn, altcp_sent_fn sent);
+void altcp_poll(struct altcp_pcb* conn, altcp_poll_fn poll, u8_t interval);
+void altcp_err(struct altcp_pcb* conn, altcp_err_fn err);
+void altcp_recved(struct altcp_pcb* conn, u16_t len);
+err_t altcp_connect(
+    struct altcp_pcb* conn,
+    const ip_addr_t* ipaddr,
+    u16_t port,
+    altcp_connected_fn connected
+);
+void altcp_abort(struct altcp_pcb* conn);
+err_t altcp_close(struct altcp_pcb* conn);
+err_t altcp_write(
+    struct altcp_pcb* conn,
+    const void* dataptr,
+    u16_t len,
+    u8_t apiflags
+);
+err_t altcp_output(struct altcp_pcb* conn);
+u16_t altcp_sndbuf(struct altcp_pcb* conn);
+u16_t altcp_sndqueuelen(struct altcp_pcb* conn);
+const ip_addr_t* altcp_get_ip(struct altcp_pcb* conn, int local);
+struct altcp_tls_config;
+struct altcp_tls_config* altcp_tls_create_config_client(
+    const u8_t* cert,
+    size_t cert_len
+);
+void altcp_tls_free_config(struct altcp_tls_config* conf);
+struct altcp_pcb* altcp_tls_new(struct altcp_tls_config* config, u8_t ip_type);
+
+// Statistics
+typedef enum {
+    MEMP_RAW_PCB, MEMP_UDP_PCB, MEMP_TCP_PCB, MEMP_TCP_SEG, MEMP_PBUF,
+    MEMP_PBUF_POOL, MEMP_MAX
+} memp_t;
+struct stats_mem {
+    const char* name;
+    u16_t err;
+    u16_t avail;
+    u16_t used;
+    u16_t max;
+};
+struct stats_proto { u16_t xmit, recv, drop; };
+struct stats_tcp { u16_t xmit, recv, drop, rexmit; };
+struct stats_ {
+    struct stats_proto link;
+    struct stats_tcp tcp;
+    struct stats_mem mem;
+    struct stats_mem* memp[MEMP_MAX];
+};
+extern struct stats_ lwip_stats;
+
+
+/* Pico SDK *******************************************************************/
+
+// Time
+typedef uint64_t absolute_time_t;
+#define nil_time                                    ((absolute_time_t)0)
+#define at_the_end_of_time                          ((absolute_time_t)-1)
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+uint32_t to_ms_since_boot(absolute_time_t t);
+bool time_reached(absolute_time_t t);
+bool is_nil_time(absolute_time_t t);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void sleep_ms(uint32_t ms);
+
+// Standard I/O
+typedef struct stdio_driver stdio_driver_t;
+extern stdio_driver_t stdio_usb;
+bool stdio_usb_init(void);
+void stdio_set_translate_crlf(stdio_driver_t* driver, bool translate);
+
+// Platform
+#define __compiler_memory_barrier()                 __asm__ volatile("" ::: "memory")
+#define XIP_BASE                                    ((uintptr_t)0x10000000)
+#define PICO_FLASH_SIZE_BYTES                       (2 * 1024 * 1024)
+uint32_t get_rand_32(void);
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+// Flash
+#define FLASH_PAGE_SIZE                             (1u << 8)
+#define FLASH_SECTOR_SIZE                           (1u << 12)
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(
+    uint32_t flash_offs,
+    const uint8_t* data,
+    size_t count
+);
+
+// Wireless
+#define CYW43_COUNTRY_SWEDEN                        0x4553
+#define CYW43_AUTH_WPA2_AES_PSK                     0x00400004
+#define CYW43_ITF_STA                               0
+#define CYW43_LINK_DOWN                             0
+#define CYW43_LINK_JOIN                             1
+#define CYW43_LINK_NOIP                             2
+#define CYW43_LINK_UP                               3
+#define CYW43_LINK_FAIL                             -1
+#define CYW43_LINK_NONET                            -2
+#define CYW43_LINK_BADAUTH                          -3
+#define CYW43_NO_POWERSAVE_MODE                     0xa11140
+#define CYW43_PERFORMANCE_PM                        0xa11142
+#define CYW43_AGGRESSIVE_PM                         0xa11c82
+#define CYW43_DEFAULT_PM                            CYW43_PERFORMANCE_PM
+#define CYW43_NONE_PM                               0
+#define CYW43_PM1_POWERSAVE_MODE                    1
+#define CYW43_PM2_POWERSAVE_MODE                    2
+#define CYW43_IOCTL_GET_CHANNEL                     0x3a
+#define CYW43_CHANNEL_NONE                          0xffffffff
+typedef struct _cyw43_t { struct netif netif[2]; } cyw43_t;
+extern cyw43_t cyw43_state;
+uint32_t cyw43_pm_value(
+    uint8_t pm_mode,
+    uint16_t pm2_sleep_ret_ms,
+    uint8_t li_beacon_period,
+    uint8_t li_dtim_period,
+    uint8_t li_assoc
+);
+int cyw43_arch_init_with_country(uint32_t country);
+void cyw43_arch_deinit(void);
+void cyw43_arch_enable_sta_mode(void);
+int cyw43_arch_wifi_connect_timeout_ms(
+    const char* ssid,
+    const char* pw,
+    uint32_t auth,
+    uint32_t timeout
+);
+int cyw43_arch_wifi_connect_async(
+    const char* ssid,
+    const char* pw,
+    uint32_t auth
+);
+int cyw43_arch_wifi_connect_bssid_async(
+    const char* ssid,
+    const uint8_t* bssid,
+    const char* pw,
+    uint32_t auth
+);
+void cyw43_arch_lwip_begin(void);
+void cyw43_arch_lwip_end(void);
+int cyw43_wifi_pm(cyw43_t* self, uint32_t pm);
+int cyw43_wifi_get_bssid(cyw43_t* self, uint8_t* bssid);
+int cyw43_wifi_get_rssi(cyw43_t* self, int32_t* rssi);
+int cyw43_ioctl(
+    cyw43_t* self,
+    uint32_t cmd,
+    size_t len,
+    uint8_t* buf,
+    uint32_t iface
+);
+int cyw43_tcpip_link_status(cyw43_t* self, int itf);
+int cyw43_wifi_link_status(cyw43_t* self, int itf);
+int cyw43_wifi_join(
+    cyw43_t* self,
+    size_t ssid_len,
+    const uint8_t* ssid,
+    size_t key_len,
+    const uint8_t* key,
+    uint32_t auth_type,
+    const uint8_t* bssid,
+    uint32_t channel
+);
+
+
+/* Mbed TLS *******************************************************************/
+
+// Platform
+extern void* (*mbedtls_calloc)(size_t n, size_t size);
+extern void (*mbedtls_free)(void* ptr);
+int mbedtls_platform_set_calloc_free(
+    void* (*calloc_func)(size_t, size_t),
+    void (*free_func)(void*)
+);
+typedef time_t mbedtls_time_t;
+mbedtls_time_t mbedtls_time(mbedtls_time_t* timer);
+void mbedtls_debug_set_threshold(int threshold);
+
+// Hashing and encoding
+typedef struct { int unused; } mbedtls_sha1_context;
+void mbedtls_sha1_init(mbedtls_sha1_context* ctx);
+void mbedtls_sha1_free(mbedtls_sha1_context* ctx);
+int mbedtls_sha1_starts_ret(mbedtls_sha1_context* ctx);
+int mbedtls_sha1_update_ret(
+    mbedtls_sha1_context* ctx,
+    const unsigned char* input,
+    size_t ilen
+);
+int mbedtls_sha1_finish_ret(
+    mbedtls_sha1_context* ctx,
+    unsigned char output[20]
+);
+int mbedtls_sha256_ret(
+    const unsigned char* input,
+    size_t ilen,
+    unsigned char output[32],
+    int is224
+);
+int mbedtls_base64_encode(
+    unsigned char* dst,
+    size_t dlen,
+    size_t* olen,
+    const unsigned char* src,
+    size_t slen
+);
+
+// Random number generation
+typedef struct { int unused; } mbedtls_entropy_context;
+typedef struct { int reseed_counter; } mbedtls_ctr_drbg_context;
+#define MBEDTLS_CTR_DRBG_MAX_REQUEST                1024
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx);
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx);
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len);
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx);
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx);
+int mbedtls_ctr_drbg_seed(
+    mbedtls_ctr_drbg_context* ctx,
+    int (*f_entropy)(void*, unsigned char*, size_t),
+    void* p_entropy,
+    const unsigned char* custom,
+    size_t len
+);
+int mbedtls_ctr_drbg_reseed(
+    mbedtls_ctr_drbg_context* ctx,
+    const unsigned char* additional,
+    size_t len
+);
+int mbedtls_ctr_drbg_random(
+    void* p_rng,
+    unsigned char* output,
+    size_t output_len
+);
+void mbedtls_ctr_drbg_set_reseed_interval(
+    mbedtls_ctr_drbg_context* ctx,
+    int interval
+);
+
+// X.509 certificates
+typedef struct { int tag; size_t len; unsigned char* p; } mbedtls_x509_buf;
+typedef struct { int year, mon, day, hour, min, sec; } mbedtls_x509_time;
+typedef struct mbedtls_x509_crt {
+    mbedtls_x509_buf raw;
+    mbedtls_x509_buf subject_raw;
+    mbedtls_x509_buf issuer_raw;
+    mbedtls_x509_buf pk_raw;
+    mbedtls_x509_time valid_from;
+    mbedtls_x509_time valid_to;
+    struct mbedtls_x509_crt* next;
+} mbedtls_x509_crt;
+typedef struct { int unused; } mbedtls_x509_crt_profile;
+typedef int mbedtls_x509_crt_ca_cb_t(
+    void* p_ctx,
+    mbedtls_x509_crt const* child,
+    mbedtls_x509_crt** candidate_cas
+);
+extern const mbedtls_x509_crt_profile mbedtls_x509_crt_profile_default;
+#define MBEDTLS_ERR_X509_ALLOC_FAILED               -0x2880
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED         -0x2700
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt);
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt);
+int mbedtls_x509_crt_parse(
+    mbedtls_x509_crt* chain,
+    const unsigned char* buf,
+    size_t buflen
+);
+int mbedtls_x509_crt_parse_der(
+    mbedtls_x509_crt* chain,
+    const unsigned char* buf,
+    size_t buflen
+);
+int mbedtls_x509_crt_parse_der_nocopy(
+    mbedtls_x509_crt* chain,
+    const unsigned char* buf,
+    size_t buflen
+);
+int mbedtls_x509_crt_verify(
+    mbedtls_x509_crt* crt,
+    mbedtls_x509_crt* trust_ca,
+    void* ca_crl,
+    const char* cn,
+    uint32_t* flags,
+    int (*f_vrfy)(void*, mbedtls_x509_crt*, int, uint32_t*),
+    void* p_vrfy
+);
+int mbedtls_x509_crt_verify_with_ca_cb(
+    mbedtls_x509_crt* crt,
+    mbedtls_x509_crt_ca_cb_t f_ca_cb,
+    void* p_ca_cb,
+    const mbedtls_x509_crt_profile* profile,
+    const char* cn,
+    uint32_t* flags,
+    int (*f_vrfy)(void*, mbedtls_x509_crt*, int, uint32_t*),
+    void* p_vrfy
+);
+
+// SSL/TLS
+typedef enum {
+    MBEDTLS_ECP_DP_NONE = 0, MBEDTLS_ECP_DP_SECP256R1 = 3,
+    MBEDTLS_ECP_DP_SECP384R1 = 4, MBEDTLS_ECP_DP_CURVE25519 = 9
+} mbedtls_ecp_group_id;
+typedef struct { int unused; } mbedtls_ssl_config;
+typedef struct mbedtls_ssl_session {
+    size_t id_len;
+    unsigned char id[32];
+    unsigned char master[48];
+} mbedtls_ssl_session;
+typedef struct mbedtls_ssl_context {
+    const mbedtls_ssl_config* conf;
+    mbedtls_ssl_session* session;
+} mbedtls_ssl_context;
+#define MBEDTLS_SSL_VERIFY_NONE                     0
+#define MBEDTLS_SSL_VERIFY_REQUIRED                 2
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+const mbedtls_x509_crt* mbedtls_ssl_get_peer_cert(
+    const mbedtls_ssl_context* ssl
+);
+int mbedtls_ssl_get_session(
+    const mbedtls_ssl_context* ssl,
+    mbedtls_ssl_session* session
+);
+int mbedtls_ssl_set_session(
+    mbedtls_ssl_context* ssl,
+    const mbedtls_ssl_session* session
+);
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_rng(
+    mbedtls_ssl_config* conf,
+    int (*f_rng)(void*, unsigned char*, size_t),
+    void* p_rng
+);
+void mbedtls_ssl_conf_dbg(
+    mbedtls_ssl_config* conf,
+    void (*f_dbg)(void*, int, const char*, int, const char*),
+    void* p_dbg
+);
+void mbedtls_ssl_conf_ca_cb(
+    mbedtls_ssl_config* conf,
+    mbedtls_x509_crt_ca_cb_t f_ca_cb,
+    void* p_ca_cb
+);
+void mbedtls_ssl_conf_curves(
+    mbedtls_ssl_config* conf,
+    const mbedtls_ecp_group_id* curves
+);
+
+// ALTCP TLS port state
+typedef struct altcp_mbedtls_state_s {
+    mbedtls_ssl_context ssl_context;
+} altcp_mbedtls_state_t;
+
+
+
+/* Host ***********************************************************************/
+
+// Initialise host support
+//
+//  Attach lwIP memory pool statistics. Call before anything else.
+//
+void host_init(void);
+
+// Heap allocations
+//
+//  Counted by host.c (C library allocator, wrapped at link time): made in
+//  total (see PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS), and outstanding (count,
+//  bytes).
+//
+extern u32_t host_allocations;
+extern u32_t host_heap_count;
+extern size_t host_heap_used;
+
+
+#endif //PICOHTTPS_HOST_H
@@ -0,0 +1,22 @@
+/* Host receive benchmark for Pico HTTPS example ******************************
+ *                                                                            *
+ *  Replays a receive trace (see PICOHTTPS_RECV_BENCHMARK) through the        *
+ *  receive path of picohttps.c (output sink, response parser) on the host,   *
+ *  as the device does at boot. The Pico SDK, lwIP and Mbed TLS functions the *
+ *  receive path depends on are defined in host.c (see host.h).               *
+ *                                                                            *
+ ******************************************************************************/
+
+
+/* Includes *******************************************************************/
+
+#include "host.h"                   // Pico SDK, lwIP, Mbed TLS stand-ins
+#include "picohttps.h"              // Options, macros, forward declarations
+
+
+/* Main ***********************************************************************/
+
+int main(void){
+    host_init();
+    return recv_benchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
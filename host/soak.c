@@ -0,0 +1,400 @@
+/* Host connection soak test for Pico HTTPS example ***************************
+ *                                                                            *
+ *  Runs the connection lifecycle of picohttps.c (connect_attempt,            *
+ *  cancel_connection, disconnect_from_host) through thousands of failing     *
+ *  cycles against a stubbed ALTCP TLS layer, checking after each that heap   *
+ *  usage has returned to a baseline. Defines the Pico SDK, lwIP and Mbed     *
+ *  TLS functions the lifecycle depends on, beyond those common to the host   *
+ *  executables (see host.h, host.c).                                         *
+ *                                                                            *
+ ******************************************************************************/
+
+
+/* Includes *******************************************************************/
+
+#include "host.h"                   // Pico SDK, lwIP, Mbed TLS stand-ins
+#include "picohttps.h"              // Options, macros, forward declarations
+
+
+/* Options ********************************************************************/
+
+// Soak test cycles
+//
+//  Cycling through each way a connection can fail (enum soak_cycle).
+//
+#ifndef PICOHTTPS_SOAK_CYCLES
+#define PICOHTTPS_SOAK_CYCLES                       5000
+#endif //PICOHTTPS_SOAK_CYCLES
+
+
+/* Data structures ************************************************************/
+
+// Soak test cycle
+//
+//  How the connection attempt ends. lwIP frees the PCB of a connection it
+//  aborts (refused, failed handshake) before signalling the error; the
+//  application frees it otherwise.
+//
+enum soak_cycle {
+    SOAK_REFUSED,                   // Reset (RST) whilst connecting
+    SOAK_HANDSHAKE_FAILED,          // Aborted by TLS once TCP established
+    SOAK_CANCELLED,                 // Aborted by application (lost race)
+    SOAK_CLOSED,                    // Closed by application
+    SOAK_UNROUTABLE,                // altcp_connect fails
+    SOAK_CYCLE_KINDS
+};
+
+// TLS configuration
+//
+//  Allocated from the lwIP heap; the parsed CA certificate from the Mbed TLS
+//  heap.
+//
+struct altcp_tls_config {
+    void* ca_cert;
+};
+
+// TCP + TLS protocol control block
+//
+//  TLS PCB, its inner TCP PCB, and TLS state, allocated together from the
+//  lwIP heap; record buffers (in and out, 16 KiB each) and SNI hostname from
+//  the Mbed TLS heap.
+//
+struct soak_pcb {
+    struct altcp_pcb pcb;           // First; cast to and from
+    struct altcp_pcb inner_pcb;
+    struct tcp_pcb tcp_pcb;
+    altcp_mbedtls_state_t state;
+    mbedtls_ssl_config conf;
+    void* records;
+    char* hostname;
+    altcp_err_fn err;
+};
+
+
+/* Globals ********************************************************************/
+
+// Mbed TLS allocator
+//
+//  Replaced by picohttps.c (init_stats) with its tracking allocator.
+//
+void* (*mbedtls_calloc)(size_t n, size_t size) = calloc;
+void (*mbedtls_free)(void* ptr) = free;
+
+// Next altcp_connect fails
+static bool unroutable;
+
+
+/* Function prototypes ********************************************************/
+
+// Soak test cycle
+//
+//  Attempt connection, end it as `cycle` dictates and free it.
+//
+//  @return     `true` if ended as expected
+//
+static bool soak_cycle(enum soak_cycle cycle);
+
+// lwIP heap allocation (tracked)
+//
+//  Counted in lwIP heap statistics (lwip_stats.mem), as mem_malloc/mem_free.
+//
+static void* lwip_heap_calloc(size_t size);
+static void lwip_heap_free(void* ptr);
+
+// Free TCP + TLS protocol control block
+//
+//  As lwIP does on close or abort, signalling `err` (if not ERR_OK) to the
+//  error callback, if any.
+//
+static void soak_pcb_free(struct altcp_pcb* pcb, err_t err);
+
+
+/* Main ***********************************************************************/
+
+int main(void){
+
+    host_init();
+    if(!init_stats()){
+        printf("Failed to initialise statistics\n");
+        return EXIT_FAILURE;
+    }
+
+    // Baseline
+    struct picohttps_stats baseline;
+    stats_snapshot(&baseline);
+    u32_t baseline_count = host_heap_count;
+    size_t baseline_used = host_heap_used;
+    u32_t allocations = host_allocations;
+
+    // Cycle
+    //
+    //  Heap usage must have returned to baseline after each; each leak is
+    //  reported once.
+    //
+    unsigned int failures = 0;
+    unsigned int leaks = 0;
+    for(unsigned int i = 0; i < PICOHTTPS_SOAK_CYCLES; i++){
+        enum soak_cycle cycle = i % SOAK_CYCLE_KINDS;
+        if(!soak_cycle(cycle)){
+            printf("Soak cycle %u (%d) ended unexpectedly\n", i, cycle);
+            failures++;
+        }
+        struct picohttps_stats usage;
+        stats_snapshot(&usage);
+        if(
+            host_heap_count != baseline_count
+            || host_heap_used != baseline_used
+            || usage.mbedtls.used != baseline.mbedtls.used
+            || usage.mbedtls.count != baseline.mbedtls.count
+            || usage.mem.used != baseline.mem.used
+        ){
+            printf(
+                "Soak cycle %u (%d) leaked: "
+                "%ld bytes (%ld allocations); "
+                "of which Mbed TLS %ld bytes (%ld allocations), "
+                "lwIP %ld bytes\n",
+                i,
+                cycle,
+                (long)(host_heap_used - baseline_used),
+                (long)(s32_t)(host_heap_count - baseline_count),
+                (long)(s32_t)(usage.mbedtls.used - baseline.mbedtls.used),
+                (long)(s32_t)(usage.mbedtls.count - baseline.mbedtls.count),
+                (long)(usage.mem.used - baseline.mem.used)
+            );
+            leaks++;
+            baseline = usage;
+            baseline_count = host_heap_count;
+            baseline_used = host_heap_used;
+        }
+    }
+
+    // Report
+    //
+    //  Allocations must have been made (and freed) for the test to be
+    //  meaningful.
+    //
+    allocations = host_allocations - allocations;
+    printf(
+        "Soak test: %u cycles, %lu allocations, %u ending unexpectedly, "
+        "%u leaking\n",
+        PICOHTTPS_SOAK_CYCLES,
+        (unsigned long)allocations,
+        failures,
+        leaks
+    );
+    return allocations && !failures && !leaks ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+
+/* Functions ******************************************************************/
+
+// Soak test cycle
+static bool soak_cycle(enum soak_cycle cycle){
+
+    // Attempt connection
+    ip_addr_t ipaddr;
+    ip_addr_set_ip4_u32(&ipaddr, PP_HTONL(0xc0000201));     // 192.0.2.1
+    struct altcp_callback_arg* connection;
+    unroutable = cycle == SOAK_UNROUTABLE;
+    if(!connect_attempt(
+        &ipaddr,
+        PICOHTTPS_HOSTNAME,
+        LWIP_IANA_PORT_HTTPS,
+        &connection
+    )) return cycle == SOAK_UNROUTABLE && !connection;
+    if(cycle == SOAK_UNROUTABLE){
+        cancel_connection(connection);
+        return false;
+    }
+    bool expected = connection->state == CONNECTION_CONNECTING;
+
+    // End connection
+    //
+    //  As lwIP would, from callback context; then as connect_to_host would.
+    //
+    struct soak_pcb* pcb = (struct soak_pcb*)(connection->pcb);
+    switch(cycle){
+        case SOAK_REFUSED:
+            expected = expected && !connection_is_established(connection);
+            soak_pcb_free(&(pcb->pcb), ERR_RST);
+            expected = expected && connection->state == CONNECTION_ABORTED;
+            expected = expected && connection->err == ERR_RST;
+            cancel_connection(connection);
+            break;
+        case SOAK_HANDSHAKE_FAILED:
+            pcb->tcp_pcb.state = ESTABLISHED;
+            expected = expected && connection_is_established(connection);
+            soak_pcb_free(&(pcb->pcb), ERR_ABRT);
+            expected = expected && connection->state == CONNECTION_ABORTED;
+            expected = expected && !connection_is_established(connection);
+            cancel_connection(connection);
+            break;
+        case SOAK_CANCELLED:
+            cancel_connection(connection);
+            break;
+        case SOAK_CLOSED:
+            disconnect_from_host(connection);
+            break;
+        default:
+            return false;
+    }
+    return expected;
+
+}
+
+// lwIP heap allocation (tracked)
+static void* lwip_heap_calloc(size_t size){
+    max_align_t* block = calloc(1, sizeof(*block) + size);
+    if(!block){
+        lwip_stats.mem.err++;
+        return NULL;
+    }
+    *((size_t*)block) = size;
+    lwip_stats.mem.used += size;
+    lwip_stats.mem.max = LWIP_MAX(lwip_stats.mem.max, lwip_stats.mem.used);
+    return block + 1;
+}
+
+// lwIP heap deallocation (tracked)
+static void lwip_heap_free(void* ptr){
+    if(!ptr) return;
+    max_align_t* block = ((max_align_t*)ptr) - 1;
+    lwip_stats.mem.used -= *((size_t*)block);
+    free(block);
+}
+
+// Free TCP + TLS protocol control block
+static void soak_pcb_free(struct altcp_pcb* pcb, err_t err){
+    struct soak_pcb* soak_pcb = (struct soak_pcb*)pcb;
+    altcp_err_fn callback = soak_pcb->err;
+    void* arg = soak_pcb->pcb.arg;
+    mbedtls_free(soak_pcb->records);
+    mbedtls_free(soak_pcb->hostname);
+    lwip_heap_free(soak_pcb);
+    if(err != ERR_OK && callback) callback(arg, err);
+}
+
+// Mbed TLS allocator
+int mbedtls_platform_set_calloc_free(
+    void* (*calloc_func)(size_t, size_t),
+    void (*free_func)(void*)
+){
+    mbedtls_calloc = calloc_func;
+    mbedtls_free = free_func;
+    return 0;
+}
+
+// TLS configuration
+struct altcp_tls_config* altcp_tls_create_config_client(
+    const u8_t* cert,
+    size_t cert_len
+){
+    struct altcp_tls_config* config = lwip_heap_calloc(sizeof(*config));
+    if(!config) return NULL;
+    if(cert && !(config->ca_cert = mbedtls_calloc(1, cert_len))){
+        lwip_heap_free(config);
+        return NULL;
+    }
+    return config;
+}
+void altcp_tls_free_config(struct altcp_tls_config* conf){
+    mbedtls_free(conf->ca_cert);
+    lwip_heap_free(conf);
+}
+
+// TCP + TLS protocol control block
+struct altcp_pcb* altcp_tls_new(struct altcp_tls_config* config, u8_t ip_type){
+    struct soak_pcb* pcb = lwip_heap_calloc(sizeof(*pcb));
+    if(!pcb) return NULL;
+    if(!(pcb->records = mbedtls_calloc(2, 16384))){
+        lwip_heap_free(pcb);
+        return NULL;
+    }
+    pcb->pcb.inner_conn = &(pcb->inner_pcb);
+    pcb->pcb.state = &(pcb->state);
+    pcb->inner_pcb.state = &(pcb->tcp_pcb);
+    pcb->tcp_pcb.state = CLOSED;
+    pcb->state.ssl_context.conf = &(pcb->conf);
+    return &(pcb->pcb);
+}
+void altcp_arg(struct altcp_pcb* conn, void* arg){
+    conn->arg = arg;
+}
+void altcp_err(struct altcp_pcb* conn, altcp_err_fn err){
+    ((struct soak_pcb*)conn)->err = err;
+}
+void altcp_recv(struct altcp_pcb* conn, altcp_recv_fn recv){}
+void altcp_sent(struct altcp_pcb* conn, altcp_sent_fn sent){}
+void altcp_poll(struct altcp_pcb* conn, altcp_poll_fn poll, u8_t interval){}
+err_t altcp_connect(
+    struct altcp_pcb* conn,
+    const ip_addr_t* ipaddr,
+    u16_t port,
+    altcp_connected_fn connected
+){
+    if(unroutable) return ERR_RTE;
+    ((struct soak_pcb*)conn)->tcp_pcb.state = SYN_SENT;
+    return ERR_OK;
+}
+err_t altcp_close(struct altcp_pcb* conn){
+    soak_pcb_free(conn, ERR_OK);
+    return ERR_OK;
+}
+void altcp_abort(struct altcp_pcb* conn){
+    soak_pcb_free(conn, ERR_ABRT);
+}
+
+// SSL/TLS
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname){
+    struct soak_pcb* pcb = (struct soak_pcb*)(
+        (u8_t*)ssl - offsetof(struct soak_pcb, state.ssl_context)
+    );
+    mbedtls_free(pcb->hostname);
+    pcb->hostname = mbedtls_calloc(1, strlen(hostname) + 1);
+    if(!pcb->hostname) return MBEDTLS_ERR_X509_ALLOC_FAILED;
+    strcpy(pcb->hostname, hostname);
+    return 0;
+}
+int mbedtls_ssl_set_session(
+    mbedtls_ssl_context* ssl,
+    const mbedtls_ssl_session* session
+){
+    return 0;
+}
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session){
+    memset(session, 0, sizeof(*session));
+}
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode){}
+void mbedtls_ssl_conf_rng(
+    mbedtls_ssl_config* conf,
+    int (*f_rng)(void*, unsigned char*, size_t),
+    void* p_rng
+){}
+void mbedtls_ssl_conf_curves(
+    mbedtls_ssl_config* conf,
+    const mbedtls_ecp_group_id* curves
+){}
+
+// Handshake completion and data reception
+//
+//  Not reached; no connection completes its handshake. Referenced by the
+//  callbacks connect_attempt configures.
+//
+int mbedtls_ssl_get_session(
+    const mbedtls_ssl_context* ssl,
+    mbedtls_ssl_session* session
+){
+    return -1;
+}
+int mbedtls_ctr_drbg_random(
+    void* p_rng,
+    unsigned char* output,
+    size_t output_len
+){
+    return -1;
+}
+void altcp_recved(struct altcp_pcb* conn, u16_t len){}
+u8_t pbuf_free(struct pbuf* p){
+    return 0;
+}
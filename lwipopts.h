@@ -58,6 +58,13 @@
 //
 #define LWIP_ARP                    1
 
+// Enable static ARP entries
+//
+//  Gateway hardware address is restored from flash at boot. See
+//  boot_cache_apply() in picohttps.c.
+//
+#define ETHARP_SUPPORT_STATIC_ENTRIES   1
+
 
 
 /* ICMP options ***************************************************************/
@@ -75,6 +82,19 @@
 // Enable IPv4 support
 #define LWIP_IPV4                   1
 
+// Enable IPv6 support
+//
+//  Dual-stack; AAAA and A records are both resolved and raced (Happy
+//  Eyeballs), see connect_to_host().
+//
+#define LWIP_IPV6                   1
+
+// Enable IPv6 stateless address autoconfiguration (SLAAC)
+//
+//  Global address from router advertisements; no DHCPv6 required.
+//
+#define LWIP_IPV6_AUTOCONFIG        1
+
 
 
 /* DHCP options ***************************************************************/
@@ -129,6 +149,10 @@
 #define TCP_SND_QUEUELEN            ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
 
 // TCP options
+//
+//  Keepalive timing configured per connection. See connect_to_host() in
+//  picohttps.c.
+//
 #define LWIP_TCP_KEEPALIVE          1
 
 
@@ -165,6 +189,13 @@
 //
 #define ALTCP_MBEDTLS_AUTHMODE      MBEDTLS_SSL_VERIFY_REQUIRED
 
+// Disable ALTCP TLS port allocator
+//
+//  The application installs its own (usage tracking) Mbed TLS allocator. See
+//  init_stats() in picohttps.c.
+//
+#define ALTCP_MBEDTLS_PLATFORM_ALLOC    0
+
 
 /* Network interface options **************************************************/
 
@@ -218,11 +249,21 @@
 // Disable system stats
 #define SYS_STATS                   0
 
-// Disable memory pool stats
-#define MEMP_STATS                  0
+// Enable memory pool stats
+//
+//  Pool usage high-water marks, for sizing MEMP_NUM_* options. See
+//  stats_snapshot() in picohttps.c.
+//
+#define MEMP_STATS                  1
+
+// Enable link stats
+#define LINK_STATS                  1
 
-// Disable link stats
-#define LINK_STATS                  0
+// Enable TCP stats
+//
+//  Includes retransmission count.
+//
+#define TCP_STATS                   1
 
 
 
@@ -235,6 +276,11 @@
 //#define ALTCP_MBEDTLS_DEBUG         LWIP_DBG_ON
 
 // Enable Mbed TLS debugging
+//
+//  Printed synchronously from within the handshake. Superseded by the log
+//  buffer (see callback_mbedtls_debug), for which MBEDTLS_DEBUG_C alone
+//  suffices.
+//
 //#define ALTCP_MBEDTLS_LIB_DEBUG     LWIP_DBG_ON
 
 #endif //_LWIPOPTS_EXAMPLE_COMMONH_H
@@ -63,6 +63,18 @@
 #define MBEDTLS_ECP_NIST_OPTIM                      // NIST optimizations
 #define MBEDTLS_ECDSA_DETERMINISTIC                 // Deterministic ECDSA (more secure)
 
+// Restartable elliptic curve operations
+//
+//  Bounds each ECC operation (short Weierstrass curves; not X25519) to a
+//  budget of basic operations (mbedtls_ecp_set_max_ops), the handshake
+//  returning MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS between slices. The ALTCP TLS
+//  port (lwIP 2.1) treats any such return as a failed handshake, so slicing
+//  cannot be driven from the application without patching the port; its
+//  blocking is instead measured (see `stats.tls.stall_max` in picohttps.h).
+//
+//#define MBEDTLS_ECP_RESTARTABLE                   // Restartable ECC (ECDH, ECDSA)
+//#define MBEDTLS_ECDH_LEGACY_CONTEXT               // for MBEDTLS_ECP_RESTARTABLE
+
 // Key exchange
 #define MBEDTLS_KEY_EXCHANGE_RSA_ENABLED
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
@@ -83,14 +95,29 @@
 #define MBEDTLS_SSL_EXTENDED_MASTER_SECRET          // TLS extension (RFC 7627)
 #define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH             // TLS extension (RFC 6066)
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION          // TLS extension (RFC 6066)
+#define MBEDTLS_SSL_SESSION_TICKETS                 // TLS extension (RFC 5077), session resumption
+
+// TLS sessions
+#define MBEDTLS_SSL_KEEP_PEER_CERTIFICATE           // Retain server certificate after handshake (key pinning)
 #define MBEDTLS_SSL_TRUNCATED_HMAC                  // TLS extension (RFC 6066)
 
 // Protocols
+//
+//  TLS 1.3 (1-RTT full handshake) requires Mbed TLS 3.x, and an ALTCP TLS
+//  port adapted to its API; the Mbed TLS bundled with the Pico SDK (2.28)
+//  supports up to TLS 1.2 only. With both enabled, 1.2 is negotiated with
+//  servers not supporting 1.3. Meanwhile, resumed TLS 1.2 sessions
+//  (MBEDTLS_SSL_SESSION_TICKETS) already complete in a single round trip.
+//
 #define MBEDTLS_SSL_PROTO_TLS1_2                    // Enable TLS version 1.2
+//#define MBEDTLS_SSL_PROTO_TLS1_3                  // Enable TLS version 1.3 (Mbed TLS 3.x)
+//#define MBEDTLS_SSL_TLS1_3_KEY_EXCHANGE_MODE_EPHEMERAL_ENABLED    // (EC)DHE key shares (Mbed TLS 3.x)
+//#define MBEDTLS_PSA_CRYPTO_C                      // for MBEDTLS_SSL_PROTO_TLS1_3
 
 // X.509
 #define MBEDTLS_X509_CHECK_KEY_USAGE                // Verify keyUsage extension
 #define MBEDTLS_X509_CHECK_EXTENDED_KEY_USAGE       // Verify extendedKeyUsage extension
+#define MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK   // Trusted CA lookup (CA bundle)
 
 
 
@@ -100,6 +127,8 @@
 #define MBEDTLS_CIPHER_C                            // Symmetric cipher generic code
 #define MBEDTLS_AES_C                               // AES
 #define MBEDTLS_GCM_C                               // Galois/Counter mode
+#define MBEDTLS_CHACHA20_C                          // ChaCha20 stream cipher
+#define MBEDTLS_CHACHAPOLY_C                        // ChaCha20-Poly1305 AEAD
 
 // Parsers
 #define MBEDTLS_ASN1_PARSE_C                        // ASN1
@@ -110,6 +139,7 @@
 #define MBEDTLS_MD_C                                // MD generic code
 #define MBEDTLS_MD5_C                               // MD5
 #define MBEDTLS_POLY1305_C                          // Poly1305 MAC
+#define MBEDTLS_SHA1_C                              // SHA 1 (WebSocket handshake)
 #define MBEDTLS_SHA256_C                            // SHA 256
 #define MBEDTLS_SHA512_C                            // SHA 512
 
@@ -146,6 +176,7 @@
 // Misc
 #define MBEDTLS_ERROR_C                             // Error code conversion
 #define MBEDTLS_PLATFORM_C                          // libc re-assignment
+#define MBEDTLS_PLATFORM_MEMORY                     // Runtime calloc/free replacement (heap statistics)
 
 // Debug
 //#define MBEDTLS_DEBUG_C                           // Debug functions
@@ -155,3 +186,32 @@
 
 /* Module config *************************************************************/
 
+// Cipher suites
+//
+//  Forward-secret (ECDHE) AEAD suites only, in order of preference.
+//  ChaCha20-Poly1305 is cheaper than AES-GCM without AES hardware (Cortex-M0+).
+//  Also shortens the ClientHello.
+//
+#define MBEDTLS_SSL_CIPHERSUITES                                \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,      \
+    MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,        \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,            \
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,              \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,            \
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384
+
+// Elliptic curve fixed-point optimisation
+//
+//  MBEDTLS_ECP_FIXED_POINT_OPTIM is left at its default (enabled): base point
+//  multiplications on the NIST curves use precomputed comb tables, held as
+//  constant data. X25519, offered first, does not use them.
+//
+
+// Elliptic curve window size
+//
+//  For multiplications of other points (ECDHE shared secret, ECDSA
+//  verification); tables thereof are computed on the heap per operation,
+//  2^(w - 1) points. 4 balances speed against Mbed TLS heap peak.
+//
+#define MBEDTLS_ECP_WINDOW_SIZE                     4
+
@@ -10,15 +10,32 @@
 
 /* Includes *******************************************************************/
 
+// C standard library
+#include <assert.h>                 // Connection lifecycle assertions
+#include <ctype.h>                  // HTTP header name matching
+#include <limits.h>                 // DRBG reseed interval
+#include <stddef.h>                 // offsetof
+#include <stdint.h>                 // Length overflow limits
+#include <string.h>                 // Memory copying, string handling
+
 // Pico SDK
 #include "pico/stdlib.h"            // Standard library
 #include "pico/cyw43_arch.h"        // Pico W wireless
+#include "pico/rand.h"              // Retry backoff jitter
+#include "hardware/flash.h"         // Boot cache persistence
+#include "hardware/sync.h"          // Interrupt masking for flash writes
 
 // lwIP
 #include "lwip/dns.h"               // Hostname resolution
 #include "lwip/altcp_tls.h"         // TCP + TLS (+ HTTP == HTTPS)
+#include "lwip/tcp.h"               // TCP keepalive configuration
 #include "altcp_tls_mbedtls_structs.h"
 #include "lwip/prot/iana.h"         // HTTPS port number
+#include "lwip/stats.h"             // Runtime statistics
+#include "lwip/memp.h"              // Memory pool enumeration
+#include "lwip/dhcp.h"              // DHCP lease seeding
+#include "lwip/prot/dhcp.h"         // DHCP client states
+#include "lwip/etharp.h"            // Gateway hardware address caching
 
 // Mbed TLS
 #include "mbedtls/ssl.h"            // Server Name Indication TLS extension
@@ -26,9 +43,192 @@
 #include "mbedtls/debug.h"          // Mbed TLS debugging
 #endif //MBEDTLS_DEBUG_C
 #include "mbedtls/check_config.h"
+#include "mbedtls/entropy.h"        // Long-lived DRBG
+#include "mbedtls/ctr_drbg.h"       // Long-lived DRBG
+#include "mbedtls/platform.h"       // Heap allocator replacement
+#include "mbedtls/platform_time.h"  // Pinned key expiry
+#include "mbedtls/sha256.h"         // Pinned key hashing
+#include "mbedtls/sha1.h"           // WebSocket handshake
+#include "mbedtls/base64.h"         // WebSocket handshake
+#include "mbedtls/x509_crt.h"       // Server certificate inspection
 
 // Pico HTTPS request example
 #include "picohttps.h"              // Options, macros, forward declarations
+#ifdef PICOHTTPS_CA_BUNDLE
+#include PICOHTTPS_CA_BUNDLE        // CA bundle (generated)
+#endif //PICOHTTPS_CA_BUNDLE
+#ifdef PICOHTTPS_RECV_BENCHMARK
+#include PICOHTTPS_RECV_BENCHMARK   // Receive trace (generated)
+#endif //PICOHTTPS_RECV_BENCHMARK
+
+// Batch written to send buffer in single call
+#if PICOHTTPS_BATCH_BUFFER_SIZE > TCP_SND_BUF
+#error "PICOHTTPS_BATCH_BUFFER_SIZE must not exceed TCP_SND_BUF"
+#endif
+
+// Output sink indices reduced by masking, and must hold a whole pbuf
+#if PICOHTTPS_SINK_BUFFER_SIZE & (PICOHTTPS_SINK_BUFFER_SIZE - 1)
+#error "PICOHTTPS_SINK_BUFFER_SIZE must be a power of two"
+#endif
+#if PICOHTTPS_SINK_BUFFER_SIZE < PBUF_POOL_BUFSIZE
+#error "PICOHTTPS_SINK_BUFFER_SIZE must not be less than PBUF_POOL_BUFSIZE"
+#endif
+#if PICOHTTPS_SINK_LOW_WATERMARK > PICOHTTPS_SINK_HIGH_WATERMARK
+#error "PICOHTTPS_SINK_LOW_WATERMARK must not exceed PICOHTTPS_SINK_HIGH_WATERMARK"
+#endif
+
+// Log buffer indices reduced by masking; text length held in a byte
+#if PICOHTTPS_LOG_BUFFER_SIZE & (PICOHTTPS_LOG_BUFFER_SIZE - 1)
+#error "PICOHTTPS_LOG_BUFFER_SIZE must be a power of two"
+#endif
+#if PICOHTTPS_LOG_TEXT_SIZE > 255
+#error "PICOHTTPS_LOG_TEXT_SIZE must not exceed 255"
+#endif
+
+// Receive trace segment counts held in 16 bits
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+#if PICOHTTPS_RECV_TRACE_SEGMENTS > 0xffff
+#error "PICOHTTPS_RECV_TRACE_SEGMENTS must not exceed 65535"
+#endif
+#endif //PICOHTTPS_RECV_TRACE_SIZE
+
+// Download ranges written to flash whole sectors at a time
+#if PICOHTTPS_DOWNLOAD_RANGE_SIZE % FLASH_SECTOR_SIZE
+#error "PICOHTTPS_DOWNLOAD_RANGE_SIZE must be a multiple of FLASH_SECTOR_SIZE"
+#endif
+
+// Event stream and WebSocket each hold the connection
+#if defined(PICOHTTPS_STREAM_PATH) && defined(PICOHTTPS_WEBSOCKET_PATH)
+#error "PICOHTTPS_STREAM_PATH and PICOHTTPS_WEBSOCKET_PATH are mutually exclusive"
+#endif
+
+
+/* Globals ********************************************************************/
+
+// Runtime statistics
+//
+//  Application-maintained counters (Mbed TLS heap, TLS handshakes, request
+//  bytes). Updated from lwIP callback context, so only access with lwIP lock
+//  held (or from callbacks). lwIP-maintained counters are merged in by
+//  stats_snapshot().
+//
+static struct picohttps_stats stats;
+
+// Runtime statistics upload timestamp
+static absolute_time_t stats_uploaded;
+
+// Wireless network state
+//
+//  Updated from lwIP callback context (callback_netif_link,
+//  callback_netif_status).
+//
+static struct network_state network;
+
+// Output sink
+//
+//  Filled from lwIP callback context (callback_altcp_recv), drained from main
+//  loop.
+//
+static struct output_sink sink;
+
+// Log buffer
+//
+//  Filled from lwIP callback context (PICOHTTPS_LOG, callback_mbedtls_debug),
+//  drained from main loop.
+//
+static struct log_buffer logs;
+
+// Log record formats and module names
+//
+//  Constant; remain in flash.
+//
+static const char* const log_formats[LOG_FORMAT_COUNT] = {
+#define PICOHTTPS_LOG_FORMAT(id, format) [LOG_FORMAT_ ## id] = format,
+    PICOHTTPS_LOG_FORMATS
+#undef PICOHTTPS_LOG_FORMAT
+};
+static const char* const log_modules[] = {
+    [LOG_MODULE_NET] = "net",
+    [LOG_MODULE_TCP] = "tcp",
+    [LOG_MODULE_TLS] = "tls",
+    [LOG_MODULE_HTTP] = "http"
+};
+
+// Boot cache
+//
+//  `boot_cache_resolved` receives the background DNS query result used to
+//  validate the cached server IP address.
+//
+static struct boot_cache boot_cache;
+static bool boot_cache_valid;
+static bool boot_cache_applied;
+static bool boot_cache_gateway_added;
+static bool boot_cache_resolving;
+static ip_addr_t boot_cache_resolved;
+
+// Offline queue
+static struct offline_queue offline;
+
+// Response cache
+//
+//  Updated from lwIP callback context (http_response_parse) whilst requests
+//  are pending.
+//
+static struct cache_slot cache[PICOHTTPS_CACHE_ENTRIES];
+
+// Download
+//
+//  Range buffers filled from lwIP callback context (http_response_parse)
+//  whilst ranges are pending.
+//
+static struct download download;
+
+// Event stream
+//
+//  Parsed from lwIP callback context (http_response_parse) whilst the stream
+//  response is being received.
+//
+static struct stream stream;
+
+// WebSocket
+//
+//  Parsed from lwIP callback context (http_response_parse) once the
+//  connection has been upgraded.
+//
+static struct websocket websocket;
+
+// CA bundle
+//
+//  Constant; remains in flash (XIP), and is parsed in place.
+//
+#ifdef PICOHTTPS_CA_BUNDLE
+static const u8_t ca_bundle[] = PICOHTTPS_CA_BUNDLE_DER;
+static const struct ca_bundle_entry ca_bundle_index[] =
+    PICOHTTPS_CA_BUNDLE_INDEX;
+#endif //PICOHTTPS_CA_BUNDLE
+
+// Random number generation
+//
+//  Pool consumed from lwIP callback context (callback_rng), refilled from
+//  main loop (rng_idle).
+//
+static struct rng rng;
+
+// Receive trace
+//
+//  Recorded from lwIP callback context (callback_altcp_recv), printed on
+//  exit.
+//
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+static struct recv_trace trace;
+#endif //PICOHTTPS_RECV_TRACE_SIZE
+
+// TLS session
+//
+//  Parameters of most recently established session, for resumption.
+//
+static mbedtls_ssl_session tls_session;
+static bool tls_session_valid;
 
 
 /* Main ***********************************************************************/
@@ -46,66 +246,554 @@ void main(void){
     }
     printf("Initialized CYW43\n");
 
+    // Initialise runtime statistics
+    if(!init_stats()){
+        printf("Failed to initialize statistics\n");
+        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
+        return;
+    }
+
+    // Initialise random number generation
+    //
+    //  Entropy gathered once, here, rather than with each handshake.
+    //
+    if(!init_rng()){
+        printf("Failed to initialize random number generation\n");
+        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
+        return;
+    }
+
+    // Benchmark receive path
+    //
+    //  Before any request is queued; response parsing then only delimits
+    //  responses.
+    //
+#ifdef PICOHTTPS_RECV_BENCHMARK
+    if(!recv_benchmark()) printf("Receive benchmark results diverged\n");
+#endif //PICOHTTPS_RECV_BENCHMARK
+
+    // Load cached network parameters
+    if(boot_cache_load()) printf("Loaded boot cache\n");
+
+    // Load offline queue
+    unsigned int pending = offline_queue_load();
+    if(pending) printf("Loaded offline queue (%u pending)\n", pending);
+
+    // Load response cache
+    unsigned int cached = cache_load();
+    if(cached) printf("Loaded response cache (%u entries)\n", cached);
+
+    // Queue HTTP request
+    //
+    //  Single request, so batch is sent immediately. Long-running
+    //  applications should instead accumulate requests until batch_due().
+    //
+    //  Requests stored offline (by previous sessions) are replayed first,
+    //  sharing the connection. Should they fill the batch, the request is
+    //  itself stored offline.
+    //
+    struct request_batch batch;
+    batch_init(&batch);
+    if(offline_queue_replay(&batch))
+        printf("Replaying %u request(s)\n", batch.count);
+    if(
+        !batch_enqueue(&batch, PICOHTTPS_REQUEST, LEN(PICOHTTPS_REQUEST) - 1)
+        && !offline_queue_append(
+            PICOHTTPS_REQUEST,
+            LEN(PICOHTTPS_REQUEST) - 1,
+            1
+        )
+    ){
+        printf("Failed to queue request\n");
+        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
+        return;
+    }
+
     // Connect to wireless network
     printf("Connecting to %s\n", PICOHTTPS_WIFI_SSID);
     if(!connect_to_network()){
         printf("Failed to connect to %s\n", PICOHTTPS_WIFI_SSID);
+        if(!offline_queue_persist(&batch))
+            printf("Failed to store request(s) offline\n");
         cyw43_arch_deinit();            // Deinit Pico W wireless hardware
         return;
     }
     printf("Connected to %s\n", PICOHTTPS_WIFI_SSID);
 
-    // Resolve server hostname
-    ip_addr_t ipaddr;
-    char* char_ipaddr;
-    printf("Resolving %s\n", PICOHTTPS_HOSTNAME);
-    if(!resolve_hostname(&ipaddr)){
-        printf("Failed to resolve %s\n", PICOHTTPS_HOSTNAME);
-                                        // TODO: Disconnect from network
-        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
-        return;
-    }
+    // Supervise wireless network connection
+    if(!supervise_network())
+        printf("Failed to supervise connection to %s\n", PICOHTTPS_WIFI_SSID);
+
+    // Enter wireless power saving
+    //
+    //  Radio kept in deepest power saving mode except whilst requests are in
+    //  flight.
+    //
+    if(!set_wifi_power_mode(PICOHTTPS_WIFI_PM_IDLE))
+        printf("Failed to enter wireless power saving\n");
+
+    // Queue telemetry
+    //
+    //  Example reading; received signal strength.
+    //
+#ifdef PICOHTTPS_TELEMETRY_PATH
+    int32_t rssi = 0;
     cyw43_arch_lwip_begin();
-    char_ipaddr = ipaddr_ntoa(&ipaddr);
+    cyw43_wifi_get_rssi(&cyw43_state, &rssi);
     cyw43_arch_lwip_end();
-    printf("Resolved %s (%s)\n", PICOHTTPS_HOSTNAME, char_ipaddr);
+    const struct telemetry_record telemetry[] = {
+        { "rssi", to_ms_since_boot(get_absolute_time()), (float)rssi }
+    };
+    if(!telemetry_enqueue(&batch, telemetry, LEN(telemetry)))
+        printf("Failed to queue telemetry\n");
+#endif //PICOHTTPS_TELEMETRY_PATH
+
+    // Queue configuration poll
+    //
+    //  Conditional on cached response, if any.
+    //
+#ifdef PICOHTTPS_CONFIG_PATH
+    if(!cache_enqueue(&batch, PICOHTTPS_CONFIG_PATH))
+        printf("Failed to queue configuration request\n");
+#endif //PICOHTTPS_CONFIG_PATH
+
+    // Queue download
+    //
+    //  Further ranges are queued as each batch completes.
+    //
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+    download_start(PICOHTTPS_DOWNLOAD_PATH);
+    if(!download_enqueue(&batch))
+        printf("Failed to queue download of %s\n", PICOHTTPS_DOWNLOAD_PATH);
+#endif //PICOHTTPS_DOWNLOAD_PATH
+
+    // Subscribe to event stream
+    //
+    //  Stream request is queued once no other requests are pending.
+    //
+#ifdef PICOHTTPS_STREAM_PATH
+    stream_start(PICOHTTPS_STREAM_PATH, callback_stream_event);
+#endif //PICOHTTPS_STREAM_PATH
+
+    // Connect WebSocket
+    //
+    //  Upgrade request is queued once no other requests are pending.
+    //
+#ifdef PICOHTTPS_WEBSOCKET_PATH
+    websocket_start(PICOHTTPS_WEBSOCKET_PATH, callback_websocket_message);
+#endif //PICOHTTPS_WEBSOCKET_PATH
+
+    // Send queued requests
+    //
+    //  Requests remain queued until sent. On loss of network connectivity at
+    //  any stage, rejoin network (fast path) and resume.
+    //
+    //  The connection to the server is pooled (kept open) between batches;
+    //  connections found dead (evicted by callback_altcp_poll, or reset) are
+    //  discarded before issuing requests on them.
+    //
+    //  Failures are retried with backoff (retry_wait), reusing the resolved
+    //  server address and (via resumption) TLS session. A batch is only
+    //  emptied once its response has been received.
+    //
+    unsigned int reconnects = 0;
+    unsigned int attempts = 0;
+    bool resolved = false;
+    ip_addr_t ipaddrs[PICOHTTPS_ADDRESS_FAMILIES];
+    ip_addr_t ipaddr;
+    struct altcp_pcb* pcb = NULL;
+    struct altcp_callback_arg* connection = NULL;
+    while(batch.count){
+
+        // Rejoin network if connectivity lost
+        if(!network_is_up()){
+            if(reconnects++ == PICOHTTPS_RECONNECT_ATTEMPTS){
+                printf("Failed to reconnect to %s\n", PICOHTTPS_WIFI_SSID);
+                break;
+            }
+            printf("Reconnecting to %s\n", PICOHTTPS_WIFI_SSID);
+            if(!reconnect_to_network()) continue;
+            printf("Reconnected to %s\n", PICOHTTPS_WIFI_SSID);
+            resolved = false;           // May have changed network
+        }
+
+        // Start request deadline
+        //
+        //  Bounds the whole attempt; each phase is abandoned on expiry.
+        //
+        absolute_time_t deadline = make_timeout_time_ms(
+            PICOHTTPS_HTTP_REQUEST_TIMEOUT
+        );
+
+        // Wake wireless hardware
+        if(!set_wifi_power_mode(PICOHTTPS_WIFI_PM_ACTIVE))
+            printf("Failed to exit wireless power saving\n");
+
+        // Discard dead pooled connection
+        if(connection && !connection_is_alive(connection)){
+            printf("Discarding dead connection\n");
+            sink_attach(&sink, NULL);
+            disconnect_from_host(connection);   // Free connection resources
+            connection = NULL;
+            pcb = NULL;
+        }
 
+        // Establish connection (unless pooled)
+        if(!pcb){
 
-    // Establish TCP + TLS connection with server
+            // Resolve server hostname
+            //
+            //  Unless already resolved (by an earlier attempt). IPv6 and IPv4
+            //  addresses, as available.
+            //
+            char char_ipaddr[IPADDR_STRLEN_MAX];
+            if(!resolved){
+                printf("Resolving %s\n", PICOHTTPS_HOSTNAME);
+                if(!resolve_hostname(ipaddrs, deadline)){
+                    printf("Failed to resolve %s\n", PICOHTTPS_HOSTNAME);
+                    request_timed_out(deadline, PICOHTTPS_PHASE_RESOLVE);
+                    if(!network_is_up()) continue;
+                    if(retry_wait(&attempts, PICOHTTPS_PHASE_RESOLVE)) continue;
+                    break;
+                }
+                resolved = true;
+                for(size_t i = 0; i < LEN(ipaddrs); i++){
+                    cyw43_arch_lwip_begin();
+                    bool resolved_ipaddr = ipaddr_is_resolved(&ipaddrs[i]);
+                    if(resolved_ipaddr)
+                        ipaddr_ntoa_r(&ipaddrs[i], char_ipaddr, LEN(char_ipaddr));
+                    cyw43_arch_lwip_end();
+                    if(resolved_ipaddr)
+                        printf("Resolved %s (%s)\n", PICOHTTPS_HOSTNAME, char_ipaddr);
+                }
+            }
+
+            // Establish TCP + TLS connection with server
+            //
+            //  Racing IPv6 and IPv4 addresses.
+            //
 #ifdef MBEDTLS_DEBUG_C
-    mbedtls_debug_set_threshold(PICOHTTPS_MBEDTLS_DEBUG_LEVEL);
+            mbedtls_debug_set_threshold(PICOHTTPS_MBEDTLS_DEBUG_LEVEL);
 #endif //MBEDTLS_DEBUG_C
-    struct altcp_pcb* pcb = NULL;
-    printf("Connecting to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-    if(!connect_to_host(&ipaddr, &pcb)){
-        printf("Failed to connect to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                                        // TODO: Disconnect from network
-        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
-        return;
-    }
-    printf("Connected to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
+            printf("Connecting to https://%s:%d\n", PICOHTTPS_HOSTNAME, LWIP_IANA_PORT_HTTPS);
+            bool connected = connect_to_host(ipaddrs, &pcb, deadline);
+            log_drain();
+            if(!connected){
+                printf("Failed to connect to https://%s:%d\n", PICOHTTPS_HOSTNAME, LWIP_IANA_PORT_HTTPS);
+                request_timed_out(deadline, PICOHTTPS_PHASE_CONNECT);
+                if(!network_is_up()) continue;
+                if(retry_wait(&attempts, PICOHTTPS_PHASE_CONNECT)) continue;
+                break;
+            }
+            cyw43_arch_lwip_begin();
+            ip_addr_copy(ipaddr, *altcp_get_ip(pcb, 0));    // Remote address
+            ipaddr_ntoa_r(&ipaddr, char_ipaddr, LEN(char_ipaddr));
+            cyw43_arch_lwip_end();
+            printf("Connected to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
+            connection = (struct altcp_callback_arg*)(pcb->arg);
+            sink_attach(&sink, connection);
+
+        }
+
+        // Send HTTP request batch to server
+        printf("Sending %u request(s)\n", batch.count);
+        if(!send_batch(pcb, &batch, deadline)){
+            printf("Failed to send request(s)\n");
+
+            // Free connection resources
+            //
+            //  Unless send buffer was merely full (ERR_MEM from altcp_write;
+            //  nothing written), in which case the connection is reused.
+            //
+            if(
+                request_timed_out(deadline, PICOHTTPS_PHASE_SEND)
+                || !connection_is_alive(connection)
+                || connection->err != ERR_MEM
+            ){
+                sink_attach(&sink, NULL);
+                cancel_connection(connection);
+                connection = NULL;
+                pcb = NULL;
+            }
+
+            if(!network_is_up()) continue;
+            if(retry_wait(&attempts, PICOHTTPS_PHASE_SEND)) continue;
+            break;
+        }
+        printf("Request(s) sent\n");
+
+        // Cache validated network parameters
+        if(!boot_cache_save(&ipaddr)) printf("Failed to save boot cache\n");
 
-    // Send HTTP request to server
-    printf("Sending request\n");
-    if(!send_request(pcb)){
-        printf("Failed to send request\n");
-        altcp_free_config(              // Free connection configuration
-            ((struct altcp_callback_arg*)(pcb->arg))->config
+        // Await HTTP response
+        //
+        //  Output response to stdio as it is received.
+        //
+        //  Responses are awaited until all have been delimited (see
+        //  http_response_parse), else for a fixed time, cut short by the
+        //  request deadline. Any response then outstanding is taken as timed
+        //  out, and the connection cancelled; any remainder of the response
+        //  would otherwise be taken as a response to the next batch.
+        //
+        //  An event stream is awaited for as long as it remains open, as is
+        //  a WebSocket, over which readings are sent meanwhile.
+        //
+        printf("Awaiting response\n");
+        absolute_time_t wait = make_timeout_time_ms(
+            PICOHTTPS_HTTP_RESPONSE_WAIT
         );
-        altcp_free_arg(                 // Free connection callback argument
-            (struct altcp_callback_arg*)(pcb->arg)
+        while(
+            connection_is_alive(connection)
+            && (
+                stream.active
+                || websocket.open
+                || (
+                    !time_reached(wait)
+                    && !time_reached(deadline)
+                    && connection->response.index < batch.count
+                )
+            )
+        ){
+#ifdef PICOHTTPS_WEBSOCKET_PATH
+            if(websocket.open) websocket_poll(pcb);
+#endif //PICOHTTPS_WEBSOCKET_PATH
+            log_drain();
+            if(!sink_drain(&sink)){
+                rng_idle();
+                sleep_ms(PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL);
+            }
+        }
+        sink_drain(&sink);
+        log_drain();
+        stream.active = false;              // Ended, or connection lost
+        websocket.open = false;             // Closed, or connection lost
+        int status = connection->status;
+
+        // Time out outstanding responses
+        //
+        //  Whether the wait or request deadline expired, or the connection
+        //  was lost. Not so for event streams and WebSockets, which end with
+        //  their connection and are resubscribed (below).
+        //
+        bool timed_out = (
+            connection->response.index < batch.count
+            && !stream.pending
+            && !websocket.pending
         );
-        altcp_free_pcb(pcb);            // Free connection PCB
-                                        // TODO: Disconnect from network
-        cyw43_arch_deinit();            // Deinit Pico W wireless hardware
-        return;
+        if(timed_out){
+            printf(
+                "%u response(s) outstanding\n",
+                batch.count - connection->response.index
+            );
+            request_timed_out(deadline, PICOHTTPS_PHASE_RESPONSE);
+            sink_attach(&sink, NULL);
+            cancel_connection(connection);      // Free connection resources
+            connection = NULL;
+            pcb = NULL;
+        }
+
+        // Discard upgraded connection
+        //
+        //  No longer carries HTTP.
+        //
+        if(websocket.upgraded){
+            if(connection){
+                sink_attach(&sink, NULL);
+                disconnect_from_host(connection);
+                connection = NULL;
+                pcb = NULL;
+            }
+            websocket.upgraded = false;
+        }
+        printf("Awaited response\n");
+
+        // Retry batch
+        //
+        //  On response timeout, or retryable response status. Given up on
+        //  once retries are exhausted, with the batch stored offline (below);
+        //  replayed requests are only acknowledged once answered.
+        //
+        if(timed_out){
+            if(!network_is_up()) continue;
+            if(retry_wait(&attempts, PICOHTTPS_PHASE_RESPONSE)) continue;
+            break;
+        }
+        if(status == PICOHTTPS_RETRY_HTTP_STATUS){
+            if(retry_wait(&attempts, PICOHTTPS_PHASE_STATUS)) continue;
+            break;
+        }
+
+        // Release response cache
+        cache_release();
+
+        // Write downloaded ranges
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+        if(download.path && !download_commit()){
+            printf("Failed to download %s\n", PICOHTTPS_DOWNLOAD_PATH);
+            download.path = NULL;
+        }
+#endif //PICOHTTPS_DOWNLOAD_PATH
+
+        // Serve cached configuration
+        //
+        //  If not modified since cached.
+        //
+#ifdef PICOHTTPS_CONFIG_PATH
+        const struct cache_slot* config = cache_lookup(PICOHTTPS_CONFIG_PATH);
+        if(config && config->status == 304){
+            printf("Configuration not modified (%u bytes cached)\n", config->entry.len);
+            fwrite(config->entry.body, 1, config->entry.len, stdout);
+            fflush(stdout);
+        }
+#endif //PICOHTTPS_CONFIG_PATH
+
+        // Empty batch
+        batch_init(&batch);
+        attempts = 0;
+
+        // Acknowledge replayed requests, and replay any further
+        if(offline.replayed_entries) offline_queue_ack();
+        if(offline_queue_replay(&batch))
+            printf("Replaying %u request(s)\n", batch.count);
+
+        // Queue further download ranges
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+        if(
+            download.path
+            && download.length
+            && download.offset >= download.length
+        ){
+            printf(
+                "Downloaded %s (%lu bytes)\n",
+                PICOHTTPS_DOWNLOAD_PATH,
+                (unsigned long)download.length
+            );
+            download.path = NULL;
+        } else if(download.path && !download_enqueue(&batch)){
+            printf("Failed to queue download of %s\n", PICOHTTPS_DOWNLOAD_PATH);
+        }
+#endif //PICOHTTPS_DOWNLOAD_PATH
+
+        // Upload runtime statistics
+#ifdef PICOHTTPS_STATS_UPLOAD_PATH
+        if(
+            stats_upload_due()
+            && connection
+            && connection_is_alive(connection)
+        ){
+            printf("Uploading statistics\n");
+            if(stats_upload(
+                pcb,
+                make_timeout_time_ms(PICOHTTPS_HTTP_REQUEST_TIMEOUT)
+            )) printf("Uploaded statistics\n");
+            else printf("Failed to upload statistics\n");
+        }
+#endif //PICOHTTPS_STATS_UPLOAD_PATH
+
+        // (Re)subscribe to event stream
+        //
+        //  Once no other requests are queued, as the stream holds the
+        //  connection. Resubscribed after the reconnection delay whenever it
+        //  ends, with the radio in power saving meanwhile.
+        //
+#ifdef PICOHTTPS_STREAM_PATH
+        if(stream.pending){
+            printf(
+                "Event stream ended (%lu events)\n",
+                (unsigned long)stream.events
+            );
+            cyw43_arch_lwip_begin();
+            stream.pending = 0;
+            cyw43_arch_lwip_end();
+            if(!batch.count){
+                set_wifi_power_mode(PICOHTTPS_WIFI_PM_IDLE);
+                sleep_ms(stream.retry);
+            }
+        }
+        if(stream.path && !batch.count && !stream_enqueue(&batch))
+            printf("Failed to subscribe to event stream\n");
+#endif //PICOHTTPS_STREAM_PATH
+
+        // (Re)connect WebSocket
+        //
+        //  As for the event stream.
+        //
+#ifdef PICOHTTPS_WEBSOCKET_PATH
+        if(websocket.pending){
+            printf(
+                "WebSocket closed (%lu messages)\n",
+                (unsigned long)websocket.messages
+            );
+            cyw43_arch_lwip_begin();
+            websocket.pending = 0;
+            cyw43_arch_lwip_end();
+            if(!batch.count){
+                set_wifi_power_mode(PICOHTTPS_WIFI_PM_IDLE);
+                sleep_ms(PICOHTTPS_WEBSOCKET_RETRY);
+            }
+        }
+        if(websocket.path && !batch.count && !websocket_enqueue(&batch))
+            printf("Failed to connect WebSocket\n");
+#endif //PICOHTTPS_WEBSOCKET_PATH
+
+    }
+
+    // Disconnect from server
+    if(connection){
+        sink_attach(&sink, NULL);
+        disconnect_from_host(connection);
+        sink_drain(&sink);
     }
-    printf("Request sent\n");
 
-    // Await HTTP response
-    printf("Awaiting response\n");
-    sleep_ms(5000);
-    printf("Awaited response\n");
+    // Store unsent requests offline
+    //
+    //  On giving up (retries exhausted, or network lost). Replayed in a
+    //  subsequent session. Download ranges, event stream subscriptions and
+    //  WebSocket upgrades (alone in their batch) are not stored.
+    //
+    download_dequeue(&batch);
+    if(stream.pending || websocket.pending) batch_init(&batch);
+    if(batch.count > offline.replayed_count){
+        printf(
+            "Storing %u request(s) offline\n",
+            batch.count - offline.replayed_count
+        );
+        if(!offline_queue_persist(&batch))
+            printf("Failed to store request(s) offline\n");
+    }
+
+    // Discard cached TLS session
+    tls_session_clear();
+
+    // Free random number generation
+    free_rng();
+
+    // Check for leaks
+    //
+    //  All Mbed TLS heap allocations (configuration, SSL context, peer
+    //  certificate) belong to the connection; usage must have returned to
+    //  baseline. Debug builds only.
+    //
+    assert(!stats.mbedtls.used);
+
+    // Report dropped output
+    log_drain();
+    if(sink.dropped)
+        printf("Dropped %lu bytes of output\n", (unsigned long)sink.dropped);
+    if(logs.dropped)
+        printf("Dropped %lu log records\n", (unsigned long)logs.dropped);
+
+    // Return wireless hardware to power saving
+    if(!set_wifi_power_mode(PICOHTTPS_WIFI_PM_IDLE))
+        printf("Failed to enter wireless power saving\n");
+
+    // Print runtime statistics
+    stats_print();
+
+    // Print receive trace
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+    recv_trace_print(&trace);
+#endif //PICOHTTPS_RECV_TRACE_SIZE
 
     // Return
     printf("Exiting\n");
@@ -130,9 +818,100 @@ bool init_cyw43(void){
     return !((bool)cyw43_arch_init_with_country(PICOHTTPS_INIT_CYW43_COUNTRY));
 }
 
+// Initialise runtime statistics
+bool init_stats(void){
+    stats_uploaded = nil_time;
+    return !((bool)mbedtls_platform_set_calloc_free(
+        stats_mbedtls_calloc,
+        stats_mbedtls_free
+    ));
+}
+
+// Initialise random number generation
+bool init_rng(void){
+
+    // Anchor ALTCP TLS port entropy
+    cyw43_arch_lwip_begin();
+    rng.anchor = altcp_tls_create_config_client(NULL, 0);
+    cyw43_arch_lwip_end();
+    if(!rng.anchor) return false;
+
+    // Seed DRBG
+    //
+    //  Personalised with user agent. Reseeded only by rng_idle(), never
+    //  automatically (by request count) during a handshake.
+    //
+    cyw43_arch_lwip_begin();
+    mbedtls_entropy_init(&rng.entropy);
+    mbedtls_ctr_drbg_init(&rng.drbg);
+    mbedtls_err_t mbedtls_err = mbedtls_ctr_drbg_seed(
+        &rng.drbg,
+        mbedtls_entropy_func,
+        &rng.entropy,
+        (const unsigned char*)PICOHTTPS_USER_AGENT,
+        strlen(PICOHTTPS_USER_AGENT)
+    );
+    mbedtls_ctr_drbg_set_reseed_interval(&rng.drbg, INT_MAX);
+    rng.reseeded = get_absolute_time();
+    rng.len = 0;
+    rng.misses = 0;
+    cyw43_arch_lwip_end();
+    if(mbedtls_err){
+        free_rng();
+        return false;
+    }
+
+    // Fill pool
+    return rng_idle();
+
+}
+
+// Random number generation idle work
+bool rng_idle(void){
+
+    cyw43_arch_lwip_begin();
+
+    // Reseed DRBG
+    mbedtls_err_t mbedtls_err = 0;
+    if(
+        absolute_time_diff_us(rng.reseeded, get_absolute_time())
+        >= (int64_t)PICOHTTPS_RNG_RESEED_INTERVAL * 1000
+    ){
+        mbedtls_err = mbedtls_ctr_drbg_reseed(&rng.drbg, NULL, 0);
+        if(!mbedtls_err) rng.reseeded = get_absolute_time();
+    }
+
+    // Refill pool
+    if(!mbedtls_err && rng.len < LEN(rng.pool)){
+        mbedtls_err = mbedtls_ctr_drbg_random(
+            &rng.drbg,
+            rng.pool + rng.len,
+            LEN(rng.pool) - rng.len
+        );
+        if(!mbedtls_err) rng.len = LEN(rng.pool);
+    }
+
+    cyw43_arch_lwip_end();
+    return !mbedtls_err;
+
+}
+
+// Free random number generation
+void free_rng(void){
+    cyw43_arch_lwip_begin();
+    if(rng.anchor) altcp_tls_free_config(rng.anchor);
+    rng.anchor = NULL;
+    mbedtls_ctr_drbg_free(&rng.drbg);
+    mbedtls_entropy_free(&rng.entropy);
+    memset(rng.pool, 0, LEN(rng.pool));
+    rng.len = 0;
+    cyw43_arch_lwip_end();
+}
+
 // Connect to wireless network
 bool connect_to_network(void){
     cyw43_arch_enable_sta_mode();
+    boot_cache_apply();
     return !(
         (bool)cyw43_arch_wifi_connect_timeout_ms(
             PICOHTTPS_WIFI_SSID,
@@ -143,267 +922,3718 @@ bool connect_to_network(void){
     );
 }
 
-// Resolve hostname
-bool resolve_hostname(ip_addr_t* ipaddr){
+// Boot cache checksum
+u32_t boot_cache_checksum(const struct boot_cache* cache){
+    const u8_t* byte = (const u8_t*)cache;
+    u32_t hash = 0x811c9dc5;
+    for(size_t i = 0; i < offsetof(struct boot_cache, checksum); i++){
+        hash ^= byte[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Load boot cache
+bool boot_cache_load(void){
+    const struct boot_cache* record = (const struct boot_cache*)(
+        XIP_BASE + PICOHTTPS_BOOT_CACHE_FLASH_OFFSET
+    );
+    boot_cache_valid = (
+        record->magic == PICOHTTPS_BOOT_CACHE_MAGIC
+        && record->checksum == boot_cache_checksum(record)
+    );
+    if(boot_cache_valid) boot_cache = *record;
+    boot_cache_applied = false;
+    boot_cache_gateway_added = false;
+    boot_cache_resolving = false;
+    return boot_cache_valid;
+}
 
-    // Zero address
-    ipaddr->addr = IPADDR_ANY;
+// Apply boot cache
+void boot_cache_apply(void){
+
+    if(!boot_cache_valid || boot_cache_applied) return;
+    boot_cache_applied = true;
+    struct netif* netif = &cyw43_state.netif[CYW43_ITF_STA];
 
-    // Attempt resolution
     cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = dns_gethostbyname(
-        PICOHTTPS_HOSTNAME,
-        ipaddr,
-        callback_gethostbyname,
-        ipaddr
-    );
-    cyw43_arch_lwip_end();
-    if(lwip_err == ERR_INPROGRESS){
 
-        // Await resolution
-        //
-        //  IP address will be made available shortly (by callback) upon DNS
-        //  query response.
-        //
-        while(ipaddr->addr == IPADDR_ANY)
-            sleep_ms(PICOHTTPS_RESOLVE_POLL_INTERVAL);
-        if(ipaddr->addr != IPADDR_NONE)
-            lwip_err = ERR_OK;
+    // Configure cached address
+    //
+    //  Interface is reported up (CYW43_LINK_UP) as soon as the network is
+    //  joined, rather than once DHCP completes.
+    //
+    netif_set_addr(netif, &boot_cache.ip, &boot_cache.netmask, &boot_cache.gw);
 
+    // Seed DHCP client with cached lease
+    //
+    //  lwIP provides no interface for this. However, a DHCP client in the
+    //  bound state will, on link up, request confirmation of its lease
+    //  (INIT-REBOOT) rather than performing discovery. The client state is
+    //  therefore set directly — as for SNI configuration in connect_to_host(),
+    //  this couples us to lwIP internals, but the Pico SDK already does so.
+    //
+    struct dhcp* dhcp = netif_dhcp_data(netif);
+    if(dhcp){
+        ip4_addr_copy(dhcp->offered_ip_addr, boot_cache.ip);
+        ip4_addr_copy(dhcp->offered_sn_mask, boot_cache.netmask);
+        ip4_addr_copy(dhcp->offered_gw_addr, boot_cache.gw);
+        dhcp->state = DHCP_STATE_BOUND;
     }
 
-    // Return
-    return !((bool)lwip_err);
+    cyw43_arch_lwip_end();
 
 }
 
-// Free TCP + TLS protocol control block
-void altcp_free_pcb(struct altcp_pcb* pcb){
-    cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = altcp_close(pcb);         // Frees PCB
-    cyw43_arch_lwip_end();
-    while(lwip_err != ERR_OK)
-        sleep_ms(PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL);
-        cyw43_arch_lwip_begin();
-        lwip_err = altcp_close(pcb);                // Frees PCB
-        cyw43_arch_lwip_end();
-}
+// Add cached gateway hardware address
+bool boot_cache_gateway(struct netif* netif){
 
-// Free TCP + TLS connection configuration
-void altcp_free_config(struct altcp_tls_config* config){
-    cyw43_arch_lwip_begin();
-    altcp_tls_free_config(config);
-    cyw43_arch_lwip_end();
-}
+    if(!boot_cache_applied || boot_cache_gateway_added) return false;
+    if(
+        !netif_is_link_up(netif)
+        || !ip4_addr_cmp(netif_ip4_gw(netif), &boot_cache.gw)
+    ) return false;
 
-// Free TCP + TLS connection callback argument
-void altcp_free_arg(struct altcp_callback_arg* arg){
-    if(arg){
-        free(arg);
+    // Add static entry
+    //
+    //  Static, so as not to be evicted before validation. Removed by
+    //  boot_cache_save() once validated, after which ARP maintains it.
+    //
+    lwip_err_t lwip_err = etharp_add_static_entry(
+        &boot_cache.gw,
+        &boot_cache.gw_hwaddr
+    );
+    if(lwip_err != ERR_OK){
+        PICOHTTPS_LOG(NET, 1, GATEWAY_FAILED, lwip_err);
+        return false;
     }
+    boot_cache_gateway_added = true;
+    return true;
+
 }
 
-// Establish TCP + TLS connection with server
-bool connect_to_host(ip_addr_t* ipaddr, struct altcp_pcb** pcb){
+// Resolve hostname from boot cache
+bool boot_cache_resolve(ip_addr_t* ipaddr){
+
+    if(!boot_cache_valid || boot_cache_resolving) return false;
+    boot_cache_resolving = true;
+
+    // Validate in background
+    //
+    //  Querying the cached address's family.
+    //
+    cyw43_arch_lwip_begin();
+    ip_addr_set_zero(&boot_cache_resolved);
+    lwip_err_t lwip_err = dns_gethostbyname_addrtype(
+        PICOHTTPS_HOSTNAME,
+        &boot_cache_resolved,
+        callback_gethostbyname,
+        &boot_cache_resolved,
+        IP_IS_V6(&boot_cache.server)
+            ? LWIP_DNS_ADDRTYPE_IPV6
+            : LWIP_DNS_ADDRTYPE_IPV4
+    );
+    if(lwip_err != ERR_OK && lwip_err != ERR_INPROGRESS)
+        ip_addr_set_ip4_u32(&boot_cache_resolved, IPADDR_NONE);     // Failed
+    cyw43_arch_lwip_end();
+
+    // Supply cached address
+    *ipaddr = boot_cache.server;
+    return true;
+
+}
+
+// Save boot cache
+bool boot_cache_save(const ip_addr_t* server){
+
+    struct netif* netif = &cyw43_state.netif[CYW43_ITF_STA];
+    struct boot_cache record;
+    memset(&record, 0, sizeof(record));     // Deterministic padding for checksum
+    record.magic = PICOHTTPS_BOOT_CACHE_MAGIC;
+
+    cyw43_arch_lwip_begin();
+
+    // DHCP lease
+    if(!network.lease_valid){
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    record.ip = network.ip;
+    record.netmask = network.netmask;
+    record.gw = network.gw;
+
+    // Gateway hardware address
+    struct eth_addr* hwaddr;
+    const ip4_addr_t* ipaddr;
+    if(etharp_find_addr(netif, &record.gw, &hwaddr, &ipaddr) < 0){
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    record.gw_hwaddr = *hwaddr;
+
+    // Server IP address
+    //
+    //  Prefer background DNS query result, if any.
+    //
+    if(ipaddr_is_resolved(&boot_cache_resolved))
+        record.server = boot_cache_resolved;
+    else record.server = *server;
+
+    // Hand gateway hardware address back to ARP
+    if(boot_cache_gateway_added){
+        etharp_remove_static_entry(&boot_cache.gw);
+        boot_cache_gateway_added = false;
+    }
+
+    cyw43_arch_lwip_end();
+
+    // Skip unchanged record
+    record.checksum = boot_cache_checksum(&record);
+    if(boot_cache_valid && !memcmp(&record, &boot_cache, sizeof(record)))
+        return true;
+
+    // Write record
+    //
+    //  Flash is unavailable for execution whilst erasing/programming, so
+    //  interrupts (incl. wireless driver background processing) are masked.
+    //
+    u8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xff, LEN(page));
+    memcpy(page, &record, sizeof(record));
+    u32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(PICOHTTPS_BOOT_CACHE_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(PICOHTTPS_BOOT_CACHE_FLASH_OFFSET, page, LEN(page));
+    restore_interrupts(interrupts);
+    boot_cache = record;
+    boot_cache_valid = true;
+    return true;
+
+}
+
+// Compute offline queue entry checksum
+u32_t offline_queue_checksum(
+    const struct offline_entry* entry,
+    const void* data
+){
+    const u8_t* byte = (const u8_t*)entry;
+    u32_t hash = 0x811c9dc5;
+    for(size_t i = 0; i < offsetof(struct offline_entry, checksum); i++){
+        hash ^= byte[i];
+        hash *= 0x01000193;
+    }
+    byte = (const u8_t*)data;
+    for(size_t i = 0; i < entry->len; i++){
+        hash ^= byte[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Get offline queue entry
+const struct offline_entry* offline_queue_entry(u32_t offset){
+    const struct offline_entry* entry = (const struct offline_entry*)(
+        XIP_BASE + PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + offset
+    );
+    if(
+        entry->magic != PICOHTTPS_OFFLINE_QUEUE_MAGIC
+        || PICOHTTPS_OFFLINE_ENTRY_SIZE(entry->len)
+            > FLASH_SECTOR_SIZE - offset % FLASH_SECTOR_SIZE
+        || entry->checksum != offline_queue_checksum(entry, entry + 1)
+    ) return NULL;
+    return entry;
+}
+
+// Load offline queue
+unsigned int offline_queue_load(void){
+
+    // Scan region
+    //
+    //  Head of log follows the newest entry.
+    //
+    unsigned int pending = 0;
+    offline.head = 0;
+    offline.seq = 0;
+    offline.replayed_entries = 0;
+    offline.replayed_count = 0;
+    offline.replayed_len = 0;
+    for(u32_t offset = 0; offset < PICOHTTPS_OFFLINE_QUEUE_SIZE;){
+        const struct offline_entry* entry = offline_queue_entry(offset);
+        if(!entry){
+            offset += FLASH_PAGE_SIZE;
+            continue;
+        }
+        if(entry->state) pending++;
+        if(entry->seq >= offline.seq){
+            offline.seq = entry->seq + 1;
+            offline.head = (
+                offset + PICOHTTPS_OFFLINE_ENTRY_SIZE(entry->len)
+            ) % PICOHTTPS_OFFLINE_QUEUE_SIZE;
+        }
+        offset += PICOHTTPS_OFFLINE_ENTRY_SIZE(entry->len);
+    }
+
+    // Return
+    return pending;
+
+}
+
+// Check offline queue flash erased
+bool offline_queue_erased(u32_t offset, u32_t size){
+    const u32_t* word = (const u32_t*)(
+        XIP_BASE + PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + offset
+    );
+    for(u32_t i = 0; i < size / sizeof(*word); i++)
+        if(word[i] != 0xffffffff) return false;
+    return true;
+}
+
+// Append to offline queue
+bool offline_queue_append(const char* data, u16_t len, u16_t count){
+
+    // Check entry size
+    u32_t size = PICOHTTPS_OFFLINE_ENTRY_SIZE(len);
+    if(size > FLASH_SECTOR_SIZE) return false;
+
+    // Skip to next sector
+    //
+    //  If entry would cross sector boundary, or flash at head is not erased
+    //  (e.g. following interrupted append).
+    //
+    if(
+        offline.head % FLASH_SECTOR_SIZE + size > FLASH_SECTOR_SIZE
+        || !offline_queue_erased(offline.head, size)
+    ) offline.head = (
+        (offline.head / FLASH_SECTOR_SIZE + 1) * FLASH_SECTOR_SIZE
+    ) % PICOHTTPS_OFFLINE_QUEUE_SIZE;
+
+    // Erase sector on entering it
+    //
+    //  Unless it still holds pending entries; queue is full. Oldest entries
+    //  are kept.
+    //
+    //  Flash is unavailable for execution whilst erasing/programming, so
+    //  interrupts (incl. wireless driver background processing) are masked.
+    //
+    if(
+        !(offline.head % FLASH_SECTOR_SIZE)
+        && !offline_queue_erased(offline.head, FLASH_SECTOR_SIZE)
+    ){
+        for(
+            u32_t offset = offline.head;
+            offset < offline.head + FLASH_SECTOR_SIZE;
+            offset += FLASH_PAGE_SIZE
+        ){
+            const struct offline_entry* entry = offline_queue_entry(offset);
+            if(entry && entry->state) return false;
+        }
+        u32_t interrupts = save_and_disable_interrupts();
+        flash_range_erase(
+            PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + offline.head,
+            FLASH_SECTOR_SIZE
+        );
+        restore_interrupts(interrupts);
+    }
+
+    // Build entry header
+    struct offline_entry entry;
+    memset(&entry, 0, sizeof(entry));   // Deterministic padding for checksum
+    entry.magic = PICOHTTPS_OFFLINE_QUEUE_MAGIC;
+    entry.seq = offline.seq;
+    entry.len = len;
+    entry.count = count;
+    entry.checksum = offline_queue_checksum(&entry, data);
+    entry.state = 0xffffffff;           // Pending
+
+    // Write entry
+    //
+    //  Page by page; header followed by queued requests.
+    //
+    u8_t page[FLASH_PAGE_SIZE];
+    for(u32_t written = 0; written < size; written += FLASH_PAGE_SIZE){
+        memset(page, 0xff, LEN(page));
+        for(u32_t i = 0; i < LEN(page); i++){
+            u32_t pos = written + i;
+            if(pos < sizeof(entry)) page[i] = ((const u8_t*)&entry)[pos];
+            else if(pos - sizeof(entry) < len) page[i] = data[pos - sizeof(entry)];
+        }
+        u32_t interrupts = save_and_disable_interrupts();
+        flash_range_program(
+            PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + offline.head + written,
+            page,
+            LEN(page)
+        );
+        restore_interrupts(interrupts);
+    }
+
+    // Advance head
+    offline.head = (offline.head + size) % PICOHTTPS_OFFLINE_QUEUE_SIZE;
+    offline.seq++;
+    return true;
+
+}
+
+// Persist request batch to offline queue
+bool offline_queue_persist(const struct request_batch* batch){
+    if(batch->count <= offline.replayed_count) return true;
+    return offline_queue_append(
+        batch->data + offline.replayed_len,
+        batch->len - offline.replayed_len,
+        batch->count - offline.replayed_count
+    );
+}
+
+// Replay offline queue
+u16_t offline_queue_replay(struct request_batch* batch){
+
+    offline.replayed_entries = 0;
+    offline.replayed_count = 0;
+    offline.replayed_len = 0;
+
+    // Load pending entries
+    //
+    //  Oldest first; each pass selects the pending entry with the lowest
+    //  sequence number following that of the previous.
+    //
+    u32_t after = 0;
+    while(offline.replayed_entries < PICOHTTPS_OFFLINE_QUEUE_REPLAY_MAX){
+
+        // Select next entry
+        const struct offline_entry* next = NULL;
+        u32_t next_offset = 0;
+        for(
+            u32_t offset = 0;
+            offset < PICOHTTPS_OFFLINE_QUEUE_SIZE;
+            offset += FLASH_PAGE_SIZE
+        ){
+            const struct offline_entry* entry = offline_queue_entry(offset);
+            if(!entry || !entry->state) continue;
+            if(offline.replayed_entries && entry->seq <= after) continue;
+            if(!next || entry->seq < next->seq){
+                next = entry;
+                next_offset = offset;
+            }
+        }
+        if(!next || next->len > LEN(batch->data) - batch->len) break;
+
+        // Queue entry's requests in batch
+        memcpy(batch->data + batch->len, next + 1, next->len);
+        batch->len += next->len;
+        if(!batch->count) batch->queued = get_absolute_time();
+        batch->count += next->count;
+
+        // Record replay
+        offline.replayed[offline.replayed_entries++] = next_offset;
+        offline.replayed_count += next->count;
+        offline.replayed_len += next->len;
+        after = next->seq;
+
+    }
+
+    // Return
+    return offline.replayed_count;
+
+}
+
+// Acknowledge replayed offline queue entries
+void offline_queue_ack(void){
+
+    // Clear entry states
+    //
+    //  Header page reprogrammed with `state` cleared; all other bits are
+    //  programmed to their current values (no change).
+    //
+    u8_t page[FLASH_PAGE_SIZE];
+    for(u16_t i = 0; i < offline.replayed_entries; i++){
+        u32_t offset = PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + offline.replayed[i];
+        memcpy(page, (const void*)(XIP_BASE + offset), LEN(page));
+        ((struct offline_entry*)page)->state = 0;
+        u32_t interrupts = save_and_disable_interrupts();
+        flash_range_program(offset, page, LEN(page));
+        restore_interrupts(interrupts);
+    }
+    offline.replayed_entries = 0;
+    offline.replayed_count = 0;
+    offline.replayed_len = 0;
+
+    // Compact
+    offline_queue_compact();
+
+}
+
+// Compact offline queue
+void offline_queue_compact(void){
+
+    // Sector containing newest entry
+    u32_t newest = (
+        (offline.head + PICOHTTPS_OFFLINE_QUEUE_SIZE - 1)
+        % PICOHTTPS_OFFLINE_QUEUE_SIZE
+    ) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE;
+
+    // Erase fully acknowledged sectors
+    for(
+        u32_t sector = 0;
+        sector < PICOHTTPS_OFFLINE_QUEUE_SIZE;
+        sector += FLASH_SECTOR_SIZE
+    ){
+        if(sector == newest) continue;
+        bool acknowledged = false;
+        for(
+            u32_t offset = sector;
+            offset < sector + FLASH_SECTOR_SIZE;
+            offset += FLASH_PAGE_SIZE
+        ){
+            const struct offline_entry* entry = offline_queue_entry(offset);
+            if(!entry) continue;
+            acknowledged = !entry->state;
+            if(!acknowledged) break;
+        }
+        if(!acknowledged) continue;
+        u32_t interrupts = save_and_disable_interrupts();
+        flash_range_erase(
+            PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET + sector,
+            FLASH_SECTOR_SIZE
+        );
+        restore_interrupts(interrupts);
+    }
+
+}
+
+// Compute response cache entry checksum
+u32_t cache_checksum(const struct cache_entry* entry){
+    const u8_t* byte = (const u8_t*)entry;
+    u32_t hash = 0x811c9dc5;
+    for(size_t i = 0; i < offsetof(struct cache_entry, checksum); i++){
+        hash ^= byte[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Load response cache
+unsigned int cache_load(void){
+    unsigned int loaded = 0;
+    memset(cache, 0, sizeof(cache));    // Deterministic padding for checksum
+    for(size_t i = 0; i < PICOHTTPS_CACHE_ENTRIES; i++){
+        cache[i].used = nil_time;
+#ifdef PICOHTTPS_CACHE_FLASH
+        const struct cache_entry* entry = (const struct cache_entry*)(
+            XIP_BASE + PICOHTTPS_CACHE_FLASH_OFFSET + i * FLASH_SECTOR_SIZE
+        );
+        if(
+            entry->magic == PICOHTTPS_CACHE_MAGIC
+            && entry->checksum == cache_checksum(entry)
+        ){
+            cache[i].entry = *entry;
+            loaded++;
+        }
+#endif //PICOHTTPS_CACHE_FLASH
+    }
+    return loaded;
+}
+
+// Find response cache slot
+struct cache_slot* cache_find(const char* path, bool create){
+
+    // Cached resource
+    if(strlen(path) >= PICOHTTPS_CACHE_PATH_SIZE) return NULL;
+    for(size_t i = 0; i < PICOHTTPS_CACHE_ENTRIES; i++)
+        if(!strcmp(cache[i].entry.path, path)) return &cache[i];
+    if(!create) return NULL;
+
+    // Claim empty or least recently used slot
+    //
+    //  Not one with a request pending.
+    //
+    struct cache_slot* slot = NULL;
+    for(size_t i = 0; i < PICOHTTPS_CACHE_ENTRIES; i++){
+        if(cache[i].pending) continue;
+        if(!cache[i].entry.path[0]){
+            slot = &cache[i];
+            break;
+        }
+        if(
+            !slot
+            || absolute_time_diff_us(cache[i].used, slot->used) > 0
+        ) slot = &cache[i];
+    }
+    if(!slot) return NULL;
+    cache_invalidate(slot);
+    strcpy(slot->entry.path, path);
+    slot->status = 0;
+    return slot;
+
+}
+
+// Look up cached response
+const struct cache_slot* cache_lookup(const char* path){
+    const struct cache_slot* slot = cache_find(path, false);
+    if(!slot || slot->entry.magic != PICOHTTPS_CACHE_MAGIC) return NULL;
+    return slot;
+}
+
+// Queue conditional HTTP request in batch
+bool cache_enqueue(struct request_batch* batch, const char* path){
+
+    struct cache_slot* slot = cache_find(path, true);
+    if(!slot) return false;
+
+    // Render conditional headers
+    //
+    //  Only if a valid response is cached.
+    //
+    char conditions[2 * PICOHTTPS_CACHE_VALIDATOR_SIZE + 40];
+    size_t len = 0;
+    if(slot->entry.magic == PICOHTTPS_CACHE_MAGIC){
+        if(slot->entry.etag[0]) len += snprintf(
+            conditions + len,
+            LEN(conditions) - len,
+            "If-None-Match: %s\r\n",
+            slot->entry.etag
+        );
+        if(slot->entry.last_modified[0]) len += snprintf(
+            conditions + len,
+            LEN(conditions) - len,
+            "If-Modified-Since: %s\r\n",
+            slot->entry.last_modified
+        );
+    }
+
+    // Queue request
+    //
+    //  Response matched to slot by position in batch.
+    //
+    static const struct request_segment segments[] =
+        PICOHTTPS_CACHE_REQUEST_TEMPLATE;
+    const struct request_segment holes[] = {
+        { path, strlen(path) },
+        { conditions, len }
+    };
+    u16_t index = batch->count;
+    if(!batch_enqueue_template(batch, segments, LEN(segments), holes))
+        return false;
+    slot->pending = index + 1;
+    slot->used = get_absolute_time();
+    return true;
+
+}
+
+// Invalidate response cache entry
+void cache_invalidate(struct cache_slot* slot){
+    if(slot->entry.magic == PICOHTTPS_CACHE_MAGIC) slot->dirty = true;
+    slot->entry.magic = 0;
+    slot->entry.etag[0] = '\0';
+    slot->entry.last_modified[0] = '\0';
+    slot->entry.len = 0;
+}
+
+// Release response cache slots
+void cache_release(void){
+    for(size_t i = 0; i < PICOHTTPS_CACHE_ENTRIES; i++){
+        cyw43_arch_lwip_begin();
+        cache[i].pending = 0;
+        cyw43_arch_lwip_end();
+#ifdef PICOHTTPS_CACHE_FLASH
+        if(cache[i].dirty && !cache_persist(&cache[i]))
+            printf("Failed to persist cached response\n");
+#endif //PICOHTTPS_CACHE_FLASH
+    }
+}
+
+// Persist response cache entry
+bool cache_persist(struct cache_slot* slot){
+
+    // Write entry
+    //
+    //  Page by page. Flash is unavailable for execution whilst
+    //  erasing/programming, so interrupts (incl. wireless driver background
+    //  processing) are masked.
+    //
+    u32_t offset = PICOHTTPS_CACHE_FLASH_OFFSET
+        + (slot - cache) * FLASH_SECTOR_SIZE;
+    const u8_t* data = (const u8_t*)&(slot->entry);
+    u8_t page[FLASH_PAGE_SIZE];
+    u32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+    for(u32_t written = 0; written < sizeof(slot->entry); written += LEN(page)){
+        u32_t len = LWIP_MIN(LEN(page), sizeof(slot->entry) - written);
+        memset(page, 0xff, LEN(page));
+        memcpy(page, data + written, len);
+        interrupts = save_and_disable_interrupts();
+        flash_range_program(offset + written, page, LEN(page));
+        restore_interrupts(interrupts);
+    }
+    slot->dirty = false;
+    return true;
+
+}
+
+// Start download
+void download_start(const char* path){
+    download.path = path;
+    download.offset = 0;
+    download.length = 0;
+    download.etag[0] = '\0';
+    download.pending = 0;
+    download.ranges = 0;
+    download.restart = false;
+    download.failed = false;
+}
+
+// Queue download range requests in batch
+u16_t download_enqueue(struct request_batch* batch){
+
+    if(!download.path || download.ranges) return 0;
+
+    // Render If-Range header
+    //
+    //  Once ETag known (from first response).
+    //
+    char if_range[PICOHTTPS_CACHE_VALIDATOR_SIZE + 16];
+    u16_t if_range_len = 0;
+    if(download.etag[0]) if_range_len = snprintf(
+        if_range,
+        LEN(if_range),
+        "If-Range: %s\r\n",
+        download.etag
+    );
+
+    // Queue range requests
+    //
+    //  Following the last range written, up to the resource length (once
+    //  known) and the size of the flash region.
+    //
+    static const struct request_segment segments[] =
+        PICOHTTPS_DOWNLOAD_REQUEST_TEMPLATE;
+    u16_t batch_len = batch->len;
+    u16_t index = batch->count;
+    u16_t ranges = 0;
+    for(; ranges < PICOHTTPS_DOWNLOAD_PIPELINE; ranges++){
+        u32_t first = download.offset + ranges * PICOHTTPS_DOWNLOAD_RANGE_SIZE;
+        if(download.length && first >= download.length) break;
+        if(first >= PICOHTTPS_DOWNLOAD_FLASH_SIZE) break;
+        char first_digits[10];
+        char last_digits[10];
+        const struct request_segment holes[] = {
+            { download.path, strlen(download.path) },
+            template_u32(first_digits, first),
+            template_u32(
+                last_digits,
+                first + PICOHTTPS_DOWNLOAD_RANGE_SIZE - 1
+            ),
+            { if_range, if_range_len }
+        };
+        if(!batch_enqueue_template(batch, segments, LEN(segments), holes))
+            break;
+        download.received[ranges] = 0;
+        download.complete[ranges] = false;
+    }
+
+    // Record pending ranges
+    cyw43_arch_lwip_begin();
+    download.batch_len = batch_len;
+    download.pending = ranges ? index + 1 : 0;
+    download.ranges = ranges;
+    cyw43_arch_lwip_end();
+    return ranges;
+
+}
+
+// Remove download range requests from batch
+void download_dequeue(struct request_batch* batch){
+    if(!download.ranges) return;
+    cyw43_arch_lwip_begin();
+    batch->len = download.batch_len;
+    batch->count = download.pending - 1;
+    download.pending = 0;
+    download.ranges = 0;
+    cyw43_arch_lwip_end();
+}
+
+// Parse Content-Range header
+bool download_content_range(const char* value, int range){
+
+    // Parse "bytes first-last/length"
+    //
+    //  Length may be unknown ("*"), else is nonzero. Values too large to
+    //  hold are rejected.
+    //
+    u32_t bounds[3] = { 0, 0, 0 };
+    bool length_known = true;
+    if(strncmp(value, "bytes ", 6)) return false;
+    value += 6;
+    for(size_t i = 0; i < LEN(bounds); i++){
+        if(i == 2 && *value == '*'){
+            length_known = false;
+            break;
+        }
+        if(!isdigit((unsigned char)*value)) return false;
+        for(; isdigit((unsigned char)*value); value++){
+            if(
+                bounds[i] > UINT32_MAX / 10
+                || bounds[i] * 10 > UINT32_MAX - (u32_t)(*value - '0')
+            ) return false;
+            bounds[i] = bounds[i] * 10 + (*value - '0');
+        }
+        if(i < 2 && *value++ != "-/"[i]) return false;
+    }
+
+    // Validate against request
+    u32_t first = download.offset + range * PICOHTTPS_DOWNLOAD_RANGE_SIZE;
+    if(
+        bounds[0] != first
+        || bounds[1] < bounds[0]
+        || bounds[1] - bounds[0] >= PICOHTTPS_DOWNLOAD_RANGE_SIZE
+        || (length_known && bounds[2] <= bounds[1])
+    ) return false;
+
+    // Record resource and range length
+    if(length_known) download.length = bounds[2];
+    download.received[range] = bounds[1] - bounds[0] + 1;
+    return true;
+
+}
+
+// Write received download ranges
+bool download_commit(void){
+
+    // Restart download
+    //
+    //  Resource changed; discard ranges written. Unless no ETag was sent
+    //  (If-Range), in which case ranges are unsupported.
+    //
+    bool success = !download.failed;
+    if(download.restart){
+        success = success && download.etag[0];
+        download.offset = 0;
+        download.length = 0;
+        download.etag[0] = '\0';
+        download.restart = false;
+    }
+
+    // Write ranges received in full
+    //
+    //  In order, contiguously from last range written; a short range is the
+    //  last of the resource. Flash is unavailable for execution whilst
+    //  erasing/programming, so interrupts (incl. wireless driver background
+    //  processing) are masked.
+    //
+    if(download.length > PICOHTTPS_DOWNLOAD_FLASH_SIZE) success = false;
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+    for(u16_t i = 0; success && i < download.ranges; i++){
+        if(
+            !download.complete[i]
+            || download.offset % PICOHTTPS_DOWNLOAD_RANGE_SIZE
+        ) break;
+        u32_t len = download.received[i];
+        u32_t padded = (len + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+        memset(download.data[i] + len, 0xff, padded - len);
+        u32_t offset = PICOHTTPS_DOWNLOAD_FLASH_OFFSET + download.offset;
+        u32_t interrupts = save_and_disable_interrupts();
+        flash_range_erase(offset, PICOHTTPS_DOWNLOAD_RANGE_SIZE);
+        restore_interrupts(interrupts);
+        interrupts = save_and_disable_interrupts();
+        flash_range_program(offset, download.data[i], padded);
+        restore_interrupts(interrupts);
+        download.offset += len;
+    }
+#endif //PICOHTTPS_DOWNLOAD_PATH
+
+    // Resource length
+    //
+    //  If not given (Content-Range "*/*"), inferred from a short range.
+    //
+    if(!download.length && download.offset % PICOHTTPS_DOWNLOAD_RANGE_SIZE)
+        download.length = download.offset;
+
+    // Release pending ranges
+    //
+    //  Any not written are re-requested.
+    //
+    cyw43_arch_lwip_begin();
+    download.pending = 0;
+    download.ranges = 0;
+    cyw43_arch_lwip_end();
+    return success;
+
+}
+
+// Subscribe to event stream
+void stream_start(const char* path, stream_callback_t callback){
+    stream.path = path;
+    stream.callback = callback;
+    stream.pending = 0;
+    stream.active = false;
+    stream.id[0] = '\0';
+    stream.retry = PICOHTTPS_STREAM_RETRY;
+    stream.events = 0;
+}
+
+// Queue event stream request in batch
+bool stream_enqueue(struct request_batch* batch){
+
+    if(!stream.path) return false;
+
+    // Render Last-Event-ID header
+    //
+    //  On resubscription, if the server has identified events.
+    //
+    char last_event_id[PICOHTTPS_CACHE_VALIDATOR_SIZE + 20];
+    u16_t last_event_id_len = 0;
+    if(stream.id[0]) last_event_id_len = snprintf(
+        last_event_id,
+        LEN(last_event_id),
+        "Last-Event-ID: %s\r\n",
+        stream.id
+    );
+
+    // Queue request
+    static const struct request_segment segments[] =
+        PICOHTTPS_STREAM_REQUEST_TEMPLATE;
+    const struct request_segment holes[] = {
+        { stream.path, strlen(stream.path) },
+        { last_event_id, last_event_id_len }
+    };
+    u16_t index = batch->count;
+    if(!batch_enqueue_template(batch, segments, LEN(segments), holes))
+        return false;
+    cyw43_arch_lwip_begin();
+    stream.pending = index + 1;
+    cyw43_arch_lwip_end();
+    return true;
+
+}
+
+// Parse event stream data
+//
+//  Lines are located with memchr() and copied in bulk.
+//
+void stream_parse(const u8_t* data, u16_t len){
+    while(len){
+        const u8_t* end = memchr(data, '\n', len);
+        u16_t n = end ? end - data : len;
+        u16_t copy = LWIP_MIN(n, LEN(stream.line) - 1 - stream.line_len);
+        memcpy(stream.line + stream.line_len, data, copy);
+        stream.line_len += copy;
+        if(!end) return;
+        if(stream.line_len && stream.line[stream.line_len - 1] == '\r')
+            stream.line_len--;
+        stream.line[stream.line_len] = '\0';
+        stream_line();
+        stream.line_len = 0;
+        data += n + 1;
+        len -= n + 1;
+    }
+}
+
+// Handle event stream line
+void stream_line(void){
+
+    const char* line = stream.line;
+
+    // Newline-delimited JSON
+    //
+    //  Each (non-empty) line is an event.
+    //
+    if(stream.ndjson){
+        if(!stream.line_len) return;
+        memcpy(stream.data, line, stream.line_len);
+        stream.data_len = stream.line_len;
+        stream.type[0] = '\0';
+        stream_dispatch();
+        return;
+    }
+
+    // Server-Sent Events
+    //
+    //  Blank line dispatches event; lines beginning ':' are comments (e.g.
+    //  keepalive). Fields are "name: value".
+    //
+    if(!stream.line_len){
+        if(stream.data_len) stream_dispatch();
+        stream.type[0] = '\0';
+        return;
+    }
+    if(*line == ':') return;
+    const char* value = strchr(line, ':');
+    size_t name_len = value ? (size_t)(value - line) : stream.line_len;
+    value = value ? value + 1 : line + stream.line_len;
+    if(*value == ' ') value++;
+    size_t value_len = strlen(value);
+
+    // Event data
+    //
+    //  Multiple data lines are joined with newlines.
+    //
+    if(name_len == 4 && !memcmp(line, "data", 4)){
+        if(stream.data_len && stream.data_len < LEN(stream.data) - 1)
+            stream.data[stream.data_len++] = '\n';
+        value_len = LWIP_MIN(value_len, LEN(stream.data) - 1 - stream.data_len);
+        memcpy(stream.data + stream.data_len, value, value_len);
+        stream.data_len += value_len;
+    }
+
+    // Event type
+    else if(name_len == 5 && !memcmp(line, "event", 5)){
+        if(value_len < LEN(stream.type)) strcpy(stream.type, value);
+    }
+
+    // Event ID (for resumption)
+    else if(name_len == 2 && !memcmp(line, "id", 2)){
+        if(value_len < LEN(stream.id)) strcpy(stream.id, value);
+    }
+
+    // Reconnection delay
+    else if(name_len == 5 && !memcmp(line, "retry", 5)){
+        u32_t retry = 0;
+        for(; isdigit((unsigned char)*value); value++)
+            retry = retry * 10 + (*value - '0');
+        if(!*value && value_len) stream.retry = retry;
+    }
+
+}
+
+// Dispatch event stream event
+void stream_dispatch(void){
+    stream.data[stream.data_len] = '\0';
+    if(stream.callback) stream.callback(
+        stream.ndjson ? "" : (stream.type[0] ? stream.type : "message"),
+        stream.data,
+        stream.data_len
+    );
+    stream.events++;
+    stream.type[0] = '\0';
+    stream.data_len = 0;
+}
+
+// Connect WebSocket
+void websocket_start(const char* path, websocket_callback_t callback){
+    websocket.path = path;
+    websocket.callback = callback;
+    websocket.pending = 0;
+    websocket.upgraded = false;
+    websocket.open = false;
+    websocket.sent = nil_time;
+    websocket.messages = 0;
+}
+
+// Queue WebSocket upgrade request in batch
+bool websocket_enqueue(struct request_batch* batch){
+
+    if(!websocket.path) return false;
+
+    // Generate handshake key
+    //
+    //  Random 16 bytes, base64-encoded (24 characters).
+    //
+    u32_t nonce[4];
+    for(size_t i = 0; i < LEN(nonce); i++) nonce[i] = get_rand_32();
+    size_t key_len;
+    if(mbedtls_base64_encode(
+        (unsigned char*)websocket.key,
+        LEN(websocket.key),
+        &key_len,
+        (const unsigned char*)nonce,
+        sizeof nonce
+    )) return false;
+
+    // Queue request
+    static const struct request_segment segments[] =
+        PICOHTTPS_WEBSOCKET_REQUEST_TEMPLATE;
+    const struct request_segment holes[] = {
+        { websocket.path, strlen(websocket.path) },
+        { websocket.key, (u16_t)key_len }
+    };
+    u16_t index = batch->count;
+    if(!batch_enqueue_template(batch, segments, LEN(segments), holes))
+        return false;
+    cyw43_arch_lwip_begin();
+    websocket.pending = index + 1;
+    cyw43_arch_lwip_end();
+    return true;
+
+}
+
+// Validate WebSocket handshake
+bool websocket_accept(const char* value){
+
+    // Hash handshake key and GUID
+    unsigned char hash[20];
+    mbedtls_sha1_context sha1;
+    mbedtls_sha1_init(&sha1);
+    bool hashed = !mbedtls_sha1_starts_ret(&sha1)
+        && !mbedtls_sha1_update_ret(
+            &sha1,
+            (const unsigned char*)websocket.key,
+            strlen(websocket.key)
+        )
+        && !mbedtls_sha1_update_ret(
+            &sha1,
+            (const unsigned char*)PICOHTTPS_WEBSOCKET_GUID,
+            sizeof(PICOHTTPS_WEBSOCKET_GUID) - 1
+        )
+        && !mbedtls_sha1_finish_ret(&sha1, hash);
+    mbedtls_sha1_free(&sha1);
+    if(!hashed) return false;
+
+    // Compare encoded hash
+    char expected[29];
+    size_t expected_len;
+    if(mbedtls_base64_encode(
+        (unsigned char*)expected,
+        LEN(expected),
+        &expected_len,
+        hash,
+        sizeof hash
+    )) return false;
+    return !strcmp(value, expected);
+
+}
+
+// Parse WebSocket data
+void websocket_parse(
+    struct altcp_callback_arg* arg,
+    const u8_t* data,
+    u16_t len
+){
+
+    while(len && websocket.open){
+
+        // Frame header; accumulate
+        //
+        //  Length of header is known from its second byte.
+        //
+        if(!websocket.payload){
+            websocket.header[websocket.header_len++] = *data++;
+            len--;
+            const u8_t* header = websocket.header;
+            u8_t need = 2;
+            if(websocket.header_len >= 2){
+                if((header[1] & 0x7f) == 126) need += 2;
+                else if((header[1] & 0x7f) == 127) need += 8;
+                if(header[1] & 0x80) need += 4;
+            }
+            if(websocket.header_len < need) continue;
+            websocket.header_len = 0;
+
+            // Decode header
+            //
+            //  Payloads of 4 GiB or more are refused.
+            //
+            websocket.fin = header[0] & 0x80;
+            websocket.opcode = header[0] & 0x0f;
+            u32_t length = header[1] & 0x7f;
+            bool valid = !(header[1] & 0x80);   // Server frames unmasked
+            if(length == 126){
+                length = (u32_t)header[2] << 8 | header[3];
+            } else if(length == 127){
+                valid = valid && !(header[2] | header[3] | header[4] | header[5]);
+                length = (u32_t)header[6] << 24 | (u32_t)header[7] << 16
+                    | (u32_t)header[8] << 8 | header[9];
+            }
+
+            // Validate frame
+            //
+            //  Reserved bits are clear, no extension being negotiated.
+            //  Control frames are unfragmented and short, and may interleave
+            //  the fragments of a message. Data frames begin a message, or
+            //  continue the one being reassembled.
+            //
+            valid = valid && !(header[0] & 0x70);
+            switch(websocket.opcode){
+                case WEBSOCKET_OPCODE_CLOSE:
+                case WEBSOCKET_OPCODE_PING:
+                case WEBSOCKET_OPCODE_PONG:
+                    valid = valid && websocket.fin && length <= LEN(websocket.control);
+                    websocket.control_len = 0;
+                    break;
+                case WEBSOCKET_OPCODE_TEXT:
+                case WEBSOCKET_OPCODE_BINARY:
+                    valid = valid && !websocket.message_opcode;
+                    websocket.message_opcode = websocket.opcode;
+                    websocket.message_len = 0;
+                    break;
+                case WEBSOCKET_OPCODE_CONTINUATION:
+                    valid = valid && websocket.message_opcode;
+                    break;
+                default:
+                    valid = false;
+            }
+            if(!valid){
+                websocket_close(arg, 1002);         // Protocol error
+                return;
+            }
+
+            // Check message length
+            //
+            //  Messages longer than PICOHTTPS_WEBSOCKET_MESSAGE_SIZE are
+            //  refused, rather than truncated.
+            //
+            if(
+                !(websocket.opcode & 0x8)
+                && length > LEN(websocket.message) - websocket.message_len
+            ){
+                websocket_close(arg, 1009);         // Message too big
+                return;
+            }
+
+            // Begin payload
+            websocket.payload = true;
+            websocket.remaining = length;
+            if(!length) websocket_frame_received(arg);
+            continue;
+
+        }
+
+        // Frame payload; consume in bulk
+        //
+        //  Length was checked against the buffer with the frame header.
+        //
+        u16_t n = LWIP_MIN(len, websocket.remaining);
+        if(websocket.opcode & 0x8){
+            memcpy(websocket.control + websocket.control_len, data, n);
+            websocket.control_len += n;
+        } else {
+            memcpy(websocket.message + websocket.message_len, data, n);
+            websocket.message_len += n;
+        }
+        data += n;
+        len -= n;
+        websocket.remaining -= n;
+        if(!websocket.remaining) websocket_frame_received(arg);
+
+    }
+
+}
+
+// Handle received WebSocket frame
+void websocket_frame_received(struct altcp_callback_arg* arg){
+
+    websocket.payload = false;
+    switch(websocket.opcode){
+
+        // Ping; answer with pong carrying the same payload
+        case WEBSOCKET_OPCODE_PING:
+            websocket_write(
+                arg->pcb,
+                WEBSOCKET_OPCODE_PONG,
+                websocket.control,
+                websocket.control_len
+            );
+            break;
+
+        // Close; echo status code
+        case WEBSOCKET_OPCODE_CLOSE:
+            websocket_close(
+                arg,
+                websocket.control_len >= 2
+                    ? (u16_t)(websocket.control[0] << 8 | websocket.control[1])
+                    : 1000
+            );
+            break;
+
+        // Pong; unsolicited, ignored
+        case WEBSOCKET_OPCODE_PONG:
+            break;
+
+        // Message fragment; dispatch once final
+        default:
+            if(!websocket.fin) break;
+            if(websocket.callback) websocket.callback(
+                websocket.message_opcode,
+                websocket.message,
+                websocket.message_len
+            );
+            websocket.messages++;
+            websocket.message_opcode = 0;
+            websocket.message_len = 0;
+
+    }
+
+}
+
+// Close WebSocket
+void websocket_close(struct altcp_callback_arg* arg, u16_t code){
+    if(!websocket.closing){
+        const u8_t payload[] = { code >> 8, code & 0xff };
+        websocket_write(arg->pcb, WEBSOCKET_OPCODE_CLOSE, payload, LEN(payload));
+        websocket.closing = true;
+    }
+    websocket.open = false;
+}
+
+// Mask WebSocket payload
+void websocket_mask(u8_t* data, u16_t len, u32_t mask){
+    u32_t* words = (u32_t*)data;
+    u16_t n = len / 4;
+    for(u16_t i = 0; i < n; i++) words[i] ^= mask;
+    const u8_t* key = (const u8_t*)&mask;
+    for(u16_t i = n * 4; i < len; i++) data[i] ^= key[i % 4];
+}
+
+// Build WebSocket frame
+u16_t websocket_frame(
+    u32_t* buf,
+    u8_t opcode,
+    const void* data,
+    u16_t len,
+    const u8_t** frame
+){
+
+    // Payload
+    //
+    //  Copied to the word boundary following the (longest) header, and masked
+    //  in place.
+    //
+    u8_t* payload = (u8_t*)(buf + 2);
+    u32_t mask = get_rand_32();
+    memcpy(payload, data, len);
+    websocket_mask(payload, len, mask);
+
+    // Header
+    //
+    //  Built backwards from the payload; masking key, length, then FIN and
+    //  opcode.
+    //
+    u8_t* header = payload - sizeof mask;
+    memcpy(header, &mask, sizeof mask);
+    if(len < 126){
+        header -= 2;
+        header[1] = 0x80 | len;
+    } else {
+        header -= 4;
+        header[1] = 0x80 | 126;
+        header[2] = len >> 8;
+        header[3] = len & 0xff;
+    }
+    header[0] = 0x80 | opcode;
+
+    *frame = header;
+    return (u16_t)(payload + len - header);
+
+}
+
+// Write WebSocket frame
+bool websocket_write(
+    struct altcp_pcb* pcb,
+    u8_t opcode,
+    const void* data,
+    u16_t len
+){
+    if(len > PICOHTTPS_WEBSOCKET_FRAME_SIZE) return false;
+    u32_t buf[PICOHTTPS_WEBSOCKET_FRAME_WORDS];
+    const u8_t* frame;
+    u16_t frame_len = websocket_frame(buf, opcode, data, len, &frame);
+    lwip_err_t lwip_err = altcp_write(pcb, frame, frame_len, TCP_WRITE_FLAG_COPY);
+    if(lwip_err == ERR_OK) lwip_err = altcp_output(pcb);
+    if(lwip_err != ERR_OK)
+        ((struct altcp_callback_arg*)(pcb->arg))->err = lwip_err;
+    return lwip_err == ERR_OK;
+}
+
+// Send WebSocket message
+bool websocket_send(
+    struct altcp_pcb* pcb,
+    u8_t opcode,
+    const void* data,
+    u16_t len
+){
+    struct altcp_callback_arg* arg = (struct altcp_callback_arg*)(pcb->arg);
+    cyw43_arch_lwip_begin();
+    bool sent = connection_is_alive(arg)
+        && websocket.open
+        && websocket_write(pcb, opcode, data, len);
+    cyw43_arch_lwip_end();
+    return sent;
+}
+
+// Send WebSocket reading
+bool websocket_poll(struct altcp_pcb* pcb){
+
+    if(!time_reached(delayed_by_ms(websocket.sent, PICOHTTPS_WEBSOCKET_INTERVAL)))
+        return true;
+    websocket.sent = get_absolute_time();
+
+    // Take reading
+    int32_t rssi = 0;
+    cyw43_arch_lwip_begin();
+    cyw43_wifi_get_rssi(&cyw43_state, &rssi);
+    cyw43_arch_lwip_end();
+    const struct telemetry_record record = {
+        "rssi", to_ms_since_boot(websocket.sent), (float)rssi
+    };
+
+    // Encode reading
+    u8_t body[PICOHTTPS_WEBSOCKET_FRAME_SIZE];
+    struct cbor_writer writer;
+    cbor_init(&writer, body, LEN(body));
+    cbor_array(&writer, 3);
+    cbor_text(&writer, record.sensor);
+    cbor_uint(&writer, record.time);
+    cbor_float(&writer, record.value);
+    if(writer.overflow) return false;
+
+    // Send reading
+    //
+    //  Dropped if the send buffer is full; the next is sent on time.
+    //
+    return websocket_send(pcb, WEBSOCKET_OPCODE_BINARY, body, writer.len);
+
+}
+
+// Supervise wireless network connection
+bool supervise_network(void){
+
+    struct netif* netif = &cyw43_state.netif[CYW43_ITF_STA];
+
+    // Initial state
+    cyw43_arch_lwip_begin();
+    network.link_up = netif_is_link_up(netif);
+    network.bssid_valid = false;
+    network.lease_valid = false;
+    callback_netif_status(netif);       // Caches lease
+    cyw43_arch_lwip_end();
+
+    // Cache access point BSSID and channel
+    //
+    //  Channel is queried via WLC_GET_CHANNEL ioctl, the first word of the
+    //  response being the current (hardware) channel.
+    //
+    u32_t channel_info[3];
+    cyw43_arch_lwip_begin();
+    int cyw43_err = cyw43_wifi_get_bssid(&cyw43_state, network.bssid);
+    if(!cyw43_err) cyw43_err = cyw43_ioctl(
+        &cyw43_state,
+        CYW43_IOCTL_GET_CHANNEL,
+        sizeof(channel_info),
+        (u8_t*)channel_info,
+        CYW43_ITF_STA
+    );
+    if(!cyw43_err){
+        network.channel = channel_info[0];
+        network.bssid_valid = true;
+    }
+    cyw43_arch_lwip_end();
+
+    // Register callbacks
+    cyw43_arch_lwip_begin();
+    netif_set_link_callback(netif, callback_netif_link);
+    netif_set_status_callback(netif, callback_netif_status);
+    cyw43_arch_lwip_end();
+
+    // Return
+    return !((bool)cyw43_err);
+
+}
+
+// Check wireless network connectivity
+bool network_is_up(void){
+    return network.link_up && network.ip_up;
+}
+
+// Reconnect to wireless network
+bool reconnect_to_network(void){
+
+    // Already connected
+    if(network_is_up()) return true;
+
+    // Rejoin network
+    //
+    //  If link is still up (i.e. only IP address lost), DHCP client will
+    //  continue to renegotiate in the background; just await it.
+    //
+    //  Otherwise, join using cached BSSID and channel where available. This
+    //  skips the scan otherwise performed to locate the access point.
+    //
+    if(!network.link_up){
+        const char ssid[] = PICOHTTPS_WIFI_SSID;
+        const char key[] = PICOHTTPS_WIFI_PASSWORD;
+        cyw43_arch_lwip_begin();
+        int cyw43_err = cyw43_wifi_join(
+            &cyw43_state,
+            LEN(ssid) - 1,
+            (const u8_t*)ssid,
+            LEN(key) - 1,
+            (const u8_t*)key,
+            CYW43_AUTH_WPA2_AES_PSK,
+            network.bssid_valid ? network.bssid : NULL,
+            network.bssid_valid ? network.channel : CYW43_CHANNEL_NONE
+        );
+        cyw43_arch_lwip_end();
+        if(cyw43_err) network.bssid_valid = false;
+    }
+
+    // Await link and IP address
+    //
+    //  On link restoration, lwIP reconfirms the retained DHCP lease
+    //  (INIT-REBOOT) rather than performing full discovery.
+    //
+    absolute_time_t deadline = make_timeout_time_ms(PICOHTTPS_WIFI_TIMEOUT);
+    while(!network_is_up()){
+        cyw43_arch_lwip_begin();
+        int status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+        cyw43_arch_lwip_end();
+        if(status < 0 || time_reached(deadline)) break;
+        sleep_ms(PICOHTTPS_RECONNECT_POLL_INTERVAL);
+    }
+    if(network_is_up()) return true;
+
+    // Fall back to full join
+    //
+    //  Cached access point may have changed (roaming, channel change).
+    //
+    network.bssid_valid = false;
+    if(!connect_to_network()) return false;
+    return supervise_network();
+
+}
+
+// Set wireless power management mode
+bool set_wifi_power_mode(u32_t pm){
+    cyw43_arch_lwip_begin();
+    int cyw43_err = cyw43_wifi_pm(&cyw43_state, pm);
+    cyw43_arch_lwip_end();
+    return !((bool)cyw43_err);
+}
+
+// Name request phase
+const char* request_phase_name(u8_t phase){
+    switch(phase){
+        case PICOHTTPS_PHASE_RESOLVE:   return "resolve";
+        case PICOHTTPS_PHASE_CONNECT:   return "connect";
+        case PICOHTTPS_PHASE_SEND:      return "send";
+        case PICOHTTPS_PHASE_RESPONSE:  return "response";
+        case PICOHTTPS_PHASE_STATUS:    return "status";
+        default:                        return "unknown";
+    }
+}
+
+// Check request deadline
+bool request_timed_out(absolute_time_t deadline, u8_t phase){
+    if(!time_reached(deadline)) return false;
+    printf("Request timed out (%s)\n", request_phase_name(phase));
+    cyw43_arch_lwip_begin();
+    stats.request.timeout++;
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+// Compute retry backoff
+u32_t retry_backoff(unsigned int attempt){
+    u32_t ceiling = PICOHTTPS_RETRY_BACKOFF_INITIAL;
+    while(attempt-- && ceiling < PICOHTTPS_RETRY_BACKOFF_MAX) ceiling *= 2;
+    if(ceiling > PICOHTTPS_RETRY_BACKOFF_MAX)
+        ceiling = PICOHTTPS_RETRY_BACKOFF_MAX;
+    return get_rand_32() % (ceiling + 1);
+}
+
+// Await retry
+bool retry_wait(unsigned int* attempts, u8_t phase){
+
+    // Check retry policy
+    if(
+        !(PICOHTTPS_RETRY_PHASES & phase)
+        || *attempts >= PICOHTTPS_RETRY_ATTEMPTS
+    ) return false;
+
+    // Back off
+    //
+    //  Wireless hardware returned to power saving for the duration.
+    //
+    u32_t delay = retry_backoff((*attempts)++);
+    printf("Retrying (%s) in %lu ms\n", request_phase_name(phase), (unsigned long)delay);
+    cyw43_arch_lwip_begin();
+    stats.request.retry++;
+    cyw43_arch_lwip_end();
+    if(!set_wifi_power_mode(PICOHTTPS_WIFI_PM_IDLE))
+        printf("Failed to enter wireless power saving\n");
+    rng_idle();
+    sleep_ms(delay);
+    return true;
+
+}
+
+// Initialise HTTP response parser
+void http_response_init(struct http_response* response){
+    response->state = HTTP_RESPONSE_STATUS;
+    response->index = 0;
+    response->status = 0;
+    response->line_len = 0;
+    response->length_known = false;
+    response->length = 0;
+    response->remaining = 0;
+    response->cache = NULL;
+    response->capture = false;
+    response->range = -1;
+    response->chunked = false;
+    response->stream = false;
+    response->websocket = false;
+}
+
+// Parse HTTP response data
+void http_response_parse(
+    struct altcp_callback_arg* arg,
+    const struct pbuf* buf
+){
+
+    struct http_response* response = &(arg->response);
+
+    for(const struct pbuf* p = buf; p; p = p->next){
+        const u8_t* data = (const u8_t*)(p->payload);
+        u16_t len = p->len;
+        while(len){
+            switch(response->state){
+
+                // Body (or chunk); consume in bulk
+                case HTTP_RESPONSE_BODY:
+                case HTTP_RESPONSE_CHUNK: {
+                    u16_t n = LWIP_MIN(len, response->remaining);
+                    http_response_body(response, data, n);
+                    data += n;
+                    len -= n;
+                    response->remaining -= n;
+                    if(response->remaining) break;
+                    if(response->state == HTTP_RESPONSE_CHUNK)
+                        response->state = HTTP_RESPONSE_CHUNK_END;
+                    else
+                        http_response_complete(response);
+                    break;
+                }
+
+                // Body of unknown length; cannot delimit further responses
+                case HTTP_RESPONSE_UNDELIMITED:
+                    http_response_body(response, data, len);
+                    len = 0;
+                    break;
+
+                // WebSocket frames
+                case HTTP_RESPONSE_WEBSOCKET:
+                    websocket_parse(arg, data, len);
+                    len = 0;
+                    break;
+
+                // Status and header lines; accumulate, then interpret
+                default: {
+                    char c = (char)(*data++);
+                    len--;
+                    if(c == '\n'){
+                        if(
+                            response->line_len
+                            && response->line[response->line_len - 1] == '\r'
+                        ) response->line_len--;
+                        response->line[response->line_len] = '\0';
+                        http_response_line(arg);
+                        response->line_len = 0;
+                    } else if(response->line_len < LEN(response->line) - 1){
+                        response->line[response->line_len++] = c;
+                    }
+                }
+
+            }
+        }
+    }
+
+}
+
+// Handle HTTP response line
+void http_response_line(struct altcp_callback_arg* arg){
+
+    struct http_response* response = &(arg->response);
+    const char* line = response->line;
+    const char* value;
+
+    // Chunked encoding
+    //
+    //  Chunk size line (hexadecimal; extensions ignored), line ending chunk
+    //  data, and trailer lines following the last (empty) chunk. A size too
+    //  large to hold cannot be skipped, so leaves the rest of the connection
+    //  undelimited.
+    //
+    switch(response->state){
+        case HTTP_RESPONSE_CHUNK_SIZE:
+            if(!isxdigit((unsigned char)*line)) return;
+            response->remaining = 0;
+            for(; isxdigit((unsigned char)*line); line++){
+                if(response->remaining > UINT32_MAX / 16){
+                    if(response->capture) cache_invalidate(response->cache);
+                    response->capture = false;
+                    response->state = HTTP_RESPONSE_UNDELIMITED;
+                    return;
+                }
+                response->remaining = response->remaining * 16 + (
+                    isdigit((unsigned char)*line)
+                        ? *line - '0'
+                        : tolower((unsigned char)*line) - 'a' + 10
+                );
+            }
+            response->state = response->remaining
+                ? HTTP_RESPONSE_CHUNK
+                : HTTP_RESPONSE_TRAILERS;
+            return;
+        case HTTP_RESPONSE_CHUNK_END:
+            response->state = HTTP_RESPONSE_CHUNK_SIZE;
+            return;
+        case HTTP_RESPONSE_TRAILERS:
+            if(!response->line_len) http_response_complete(response);
+            return;
+        default:
+            break;
+    }
+
+    // Status line
+    //
+    //  Begins "HTTP/1.x NNN". Responses to cached requests are matched to
+    //  their cache slot; a fresh response (200) replaces the cached one.
+    //
+    if(response->state == HTTP_RESPONSE_STATUS){
+        if(!response->line_len) return;     // Blank line between responses
+        response->status = 0;
+        if(
+            response->line_len >= 12
+            && !memcmp(line, "HTTP/1.", 7)
+            && line[8] == ' '
+            && isdigit((unsigned char)line[9])
+            && isdigit((unsigned char)line[10])
+            && isdigit((unsigned char)line[11])
+        ) response->status = (line[9] - '0') * 100
+            + (line[10] - '0') * 10
+            + (line[11] - '0');
+        if(!response->index && response->status / 100 != 1)
+            arg->status = response->status;
+        response->cache = NULL;
+        for(size_t i = 0; i < PICOHTTPS_CACHE_ENTRIES; i++){
+            if(cache[i].pending == response->index + 1){
+                response->cache = &cache[i];
+                break;
+            }
+        }
+        response->capture = false;
+        if(response->cache && response->status / 100 != 1){
+            response->cache->status = response->status;
+            if(response->status == 200){
+                cache_invalidate(response->cache);
+                response->capture = true;
+            }
+        }
+
+        // Download ranges
+        //
+        //  Partial content (206) is captured once validated (Content-Range).
+        //  A full response (200) means the resource changed (If-Range) or
+        //  ranges are unsupported.
+        //
+        response->range = -1;
+        if(
+            download.ranges
+            && response->index + 1 >= download.pending
+            && response->index + 1 < download.pending + download.ranges
+        ){
+            if(response->status == 206){
+                response->range = response->index + 1 - download.pending;
+                download.received[response->range] = 0;
+            } else if(response->status == 200){
+                download.restart = true;
+            } else if(response->status / 100 != 1){
+                download.failed = true;
+            }
+        }
+
+        // Event stream
+        //
+        //  Successful (200) response to the stream request begins the stream.
+        //
+        response->stream = false;
+        if(
+            stream.pending == response->index + 1
+            && response->status / 100 != 1
+        ){
+            response->stream = response->status == 200;
+            stream.active = response->stream;
+            stream.ndjson = false;
+            stream.line_len = 0;
+            stream.type[0] = '\0';
+            stream.data_len = 0;
+        }
+
+        // WebSocket
+        //
+        //  Switching Protocols (101) in response to the upgrade request.
+        //
+        response->websocket =
+            websocket.pending == response->index + 1
+            && response->status == 101;
+        if(response->websocket){
+            websocket.accepted = false;
+            websocket.closing = false;
+            websocket.header_len = 0;
+            websocket.payload = false;
+            websocket.message_opcode = 0;
+            websocket.message_len = 0;
+        }
+
+        response->length_known = false;
+        response->length = 0;
+        response->chunked = false;
+        response->state = HTTP_RESPONSE_HEADERS;
+        return;
+    }
+
+    // End of headers
+    //
+    //  Responses without body (1xx, 204, 304) are complete. Bodies are
+    //  delimited by Content-Length or chunked encoding, else extend to the
+    //  end of the connection.
+    //
+    if(!response->line_len){
+
+        // Switching Protocols
+        //
+        //  Connection no longer carries HTTP. WebSocket frames follow if the
+        //  handshake is valid; the connection is discarded regardless, once
+        //  done with (see main).
+        //
+        if(response->status == 101){
+            bool open = response->websocket && websocket.accepted;
+            http_response_complete(response);
+            response->state = open
+                ? HTTP_RESPONSE_WEBSOCKET
+                : HTTP_RESPONSE_UNDELIMITED;
+            websocket.upgraded = true;
+            websocket.open = open;
+            return;
+        }
+
+        if(response->status / 100 == 1){
+            response->state = HTTP_RESPONSE_STATUS;     // Interim response
+            return;
+        }
+        if(response->status == 204 || response->status == 304){
+            http_response_complete(response);
+            return;
+        }
+        if(
+            response->range >= 0
+            && (
+                response->chunked
+                || !response->length_known
+                || response->length != download.received[response->range]
+            )
+        ) response->range = -1;     // Content-Range absent or mismatched
+        if(response->range >= 0) download.received[response->range] = 0;
+        if(response->chunked){
+            response->state = HTTP_RESPONSE_CHUNK_SIZE;
+            return;
+        }
+        if(!response->length_known){
+            if(response->capture) cache_invalidate(response->cache);
+            response->capture = false;
+            response->state = HTTP_RESPONSE_UNDELIMITED;
+            return;
+        }
+        if(response->capture && response->length > PICOHTTPS_CACHE_BODY_SIZE){
+            cache_invalidate(response->cache);
+            response->capture = false;
+        }
+        response->remaining = response->length;
+        response->state = HTTP_RESPONSE_BODY;
+        if(!response->remaining) http_response_complete(response);
+        return;
+    }
+
+    // Framing headers
+    //
+    //  A Content-Length that is malformed or too large to hold leaves the
+    //  body undelimited.
+    //
+    if((value = http_header_value(line, "Content-Length"))){
+        response->length = 0;
+        response->length_known = isdigit((unsigned char)*value);
+        for(; isdigit((unsigned char)*value); value++){
+            if(
+                response->length > UINT32_MAX / 10
+                || response->length * 10 > UINT32_MAX - (u32_t)(*value - '0')
+            ){
+                response->length_known = false;
+                break;
+            }
+            response->length = response->length * 10 + (*value - '0');
+        }
+        while(*value == ' ' || *value == '\t') value++;
+        if(*value) response->length_known = false;
+    } else if((value = http_header_value(line, "Transfer-Encoding"))){
+        response->chunked = strstr(value, "chunked");
+        response->length_known = false;
+        response->length = 0;
+    }
+
+    // Event stream format
+    //
+    //  Newline-delimited JSON, else Server-Sent Events.
+    //
+    if(
+        response->stream
+        && (value = http_header_value(line, "Content-Type"))
+    ) stream.ndjson = !strncmp(value, "application/x-ndjson", 20);
+
+    // WebSocket handshake
+    if(
+        response->websocket
+        && (value = http_header_value(line, "Sec-WebSocket-Accept"))
+    ) websocket.accepted = websocket_accept(value);
+
+    // Download range headers
+    //
+    //  Validated range length is held in `received` until the body begins.
+    //
+    if(response->range >= 0){
+        if((value = http_header_value(line, "Content-Range"))){
+            if(!download_content_range(value, response->range))
+                response->range = -1;
+        } else if(
+            (value = http_header_value(line, "ETag"))
+            && !download.etag[0]
+            && strncmp(value, "W/", 2)          // Strong only (If-Range)
+            && strlen(value) < LEN(download.etag)
+        ){
+            strcpy(download.etag, value);
+        }
+    }
+
+    // Cache validators
+    //
+    //  Only whilst capturing a fresh response. Values too long to store are
+    //  dropped; the response is then cached without that validator.
+    //
+    if(!response->capture) return;
+    struct cache_entry* entry = &(response->cache->entry);
+    if((value = http_header_value(line, "ETag"))){
+        if(strlen(value) < LEN(entry->etag)) strcpy(entry->etag, value);
+    } else if((value = http_header_value(line, "Last-Modified"))){
+        if(strlen(value) < LEN(entry->last_modified))
+            strcpy(entry->last_modified, value);
+    }
+
+}
+
+// Handle HTTP response body data
+void http_response_body(
+    struct http_response* response,
+    const u8_t* data,
+    u16_t len
+){
+
+    // Response cache
+    //
+    //  Chunked bodies are only found to be too large whilst capturing.
+    //
+    if(response->capture){
+        struct cache_entry* entry = &(response->cache->entry);
+        if(len > LEN(entry->body) - entry->len){
+            cache_invalidate(response->cache);
+            response->capture = false;
+            return;
+        }
+        memcpy(entry->body + entry->len, data, len);
+        entry->len += len;
+    }
+
+    // Download range
+    else if(response->range >= 0){
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+        u16_t* received = &download.received[response->range];
+        memcpy(download.data[response->range] + *received, data, len);
+        *received += len;
+#endif //PICOHTTPS_DOWNLOAD_PATH
+    }
+
+    // Event stream
+    else if(response->stream){
+        stream_parse(data, len);
+    }
+
+}
+
+// Complete HTTP response
+void http_response_complete(struct http_response* response){
+
+    // Commit captured body
+    if(response->capture){
+        struct cache_slot* slot = response->cache;
+        slot->entry.magic = PICOHTTPS_CACHE_MAGIC;
+        slot->entry.checksum = cache_checksum(&(slot->entry));
+        slot->dirty = true;
+    }
+
+    // Mark download range received
+    if(response->range >= 0) download.complete[response->range] = true;
+
+    // End event stream
+    if(response->stream) stream.active = false;
+
+    // Expect next response
+    PICOHTTPS_LOG(HTTP, 2, RESPONSE, response->index, response->status);
+    if(response->cache) response->cache->used = get_absolute_time();
+    response->index++;
+    response->cache = NULL;
+    response->capture = false;
+    response->range = -1;
+    response->stream = false;
+    response->websocket = false;
+    response->state = HTTP_RESPONSE_STATUS;
+
+}
+
+// Match HTTP header
+const char* http_header_value(const char* line, const char* name){
+    for(; *name; line++, name++)
+        if(tolower((unsigned char)*line) != tolower((unsigned char)*name))
+            return NULL;
+    if(*line++ != ':') return NULL;
+    while(*line == ' ' || *line == '\t') line++;
+    return line;
+}
+
+// Save TLS session
+void tls_session_save(const mbedtls_ssl_context* ssl){
+    tls_session_clear();
+    tls_session_valid = !mbedtls_ssl_get_session(ssl, &tls_session);
+    if(!tls_session_valid) tls_session_clear();
+}
+
+// Clear TLS session
+void tls_session_clear(void){
+    mbedtls_ssl_session_free(&tls_session);     // Reinitialises
+    tls_session_valid = false;
+}
+
+// Resolve hostname
+bool resolve_hostname(ip_addr_t* ipaddrs, absolute_time_t deadline){
+
+    // Use cached address
+    //
+    //  Alone; no other address to fall back to.
+    //
+    cyw43_arch_lwip_begin();
+    for(size_t i = 1; i < PICOHTTPS_ADDRESS_FAMILIES; i++)
+        ip_addr_set_ip4_u32(&ipaddrs[i], IPADDR_NONE);      // Failed
+    cyw43_arch_lwip_end();
+    if(boot_cache_resolve(&ipaddrs[0])) return true;
+
+    // Attempt resolution
+    //
+    //  AAAA and A queries in parallel; lwIP permits concurrent queries for
+    //  the same name with differing address types. IPv6 only if enabled
+    //  (LWIP_IPV6).
+    //
+    static const u8_t types[PICOHTTPS_ADDRESS_FAMILIES] = {
+        LWIP_DNS_ADDRTYPE_IPV6,
+        LWIP_DNS_ADDRTYPE_IPV4
+    };
+    for(size_t i = 0; i < PICOHTTPS_ADDRESS_FAMILIES; i++){
+        cyw43_arch_lwip_begin();
+        ip_addr_set_zero(&ipaddrs[i]);
+        lwip_err_t lwip_err = (LWIP_IPV6 || types[i] != LWIP_DNS_ADDRTYPE_IPV6)
+            ? dns_gethostbyname_addrtype(
+                PICOHTTPS_HOSTNAME,
+                &ipaddrs[i],
+                callback_gethostbyname,
+                &ipaddrs[i],
+                types[i]
+            )
+            : ERR_VAL;
+        if(lwip_err != ERR_OK && lwip_err != ERR_INPROGRESS)
+            ip_addr_set_ip4_u32(&ipaddrs[i], IPADDR_NONE);  // Failed
+        cyw43_arch_lwip_end();
+    }
+
+    // Await resolution
+    //
+    //  IP addresses will be made available shortly (by callback) upon DNS
+    //  query responses. Copied with lwIP lock held, as they may be written
+    //  concurrently.
+    //
+    absolute_time_t delay = nil_time;
+    while(!time_reached(deadline)){
+        cyw43_arch_lwip_begin();
+        ip_addr_t preferred = ipaddrs[0];
+        ip_addr_t fallback = ipaddrs[1];
+        cyw43_arch_lwip_end();
+        if(ipaddr_is_resolved(&preferred)) return true;
+        if(ipaddr_is_resolved(&fallback)){
+            if(ipaddr_is_failed(&preferred)) return true;
+            if(is_nil_time(delay))
+                delay = make_timeout_time_ms(PICOHTTPS_RESOLUTION_DELAY);
+            else if(time_reached(delay))
+                return true;
+        } else if(ipaddr_is_failed(&preferred) && ipaddr_is_failed(&fallback)){
+            return false;
+        }
+        sleep_ms(
+            is_nil_time(delay)
+                ? PICOHTTPS_RESOLVE_POLL_INTERVAL
+                : PICOHTTPS_RESOLUTION_DELAY
+        );
+    }
+
+    // Return
+    return false;
+
+}
+
+// Check hostname resolution
+bool ipaddr_is_resolved(const ip_addr_t* ipaddr){
+    return !ip_addr_isany(ipaddr) && !ipaddr_is_failed(ipaddr);
+}
+
+// Check hostname resolution failure
+bool ipaddr_is_failed(const ip_addr_t* ipaddr){
+    return IP_IS_V4(ipaddr)
+        && ip4_addr_get_u32(ip_2_ip4(ipaddr)) == IPADDR_NONE;
+}
+
+// Free TCP + TLS protocol control block
+void altcp_free_pcb(struct altcp_pcb* pcb){
+    cyw43_arch_lwip_begin();
+    if(altcp_close(pcb) != ERR_OK)  // Frees PCB
+        altcp_abort(pcb);           // Frees PCB (unconditionally)
+    cyw43_arch_lwip_end();
+}
+
+// Free TCP + TLS connection configuration
+void altcp_free_config(struct altcp_tls_config* config){
+    cyw43_arch_lwip_begin();
+    altcp_tls_free_config(config);
+    cyw43_arch_lwip_end();
+}
+
+// Free TCP + TLS connection callback argument
+void altcp_free_arg(struct altcp_callback_arg* arg){
+    if(arg){
+        free(arg);
+    }
+}
+
+// Establish TCP + TLS connection with server
+bool connect_to_host(
+    const ip_addr_t* ipaddrs,
+    struct altcp_pcb** pcb,
+    absolute_time_t deadline
+){
+
+    *pcb = NULL;
+    struct altcp_callback_arg* attempts[PICOHTTPS_ADDRESS_FAMILIES] = { NULL };
+    bool started[PICOHTTPS_ADDRESS_FAMILIES] = { false };
+    struct altcp_callback_arg* connected = NULL;
+    absolute_time_t due = get_absolute_time();
+
+    // Race connection attempts
+    //
+    //  Sucessful connection will be confirmed shortly in
+    //  callback_altcp_connect. Failure (incl. eviction of a stalled
+    //  handshake by callback_altcp_poll) is signalled in callback_altcp_err,
+    //  once lwIP has freed the PCB.
+    //
+    //  Handshakes are processed in lwIP (background) context; any overrun of
+    //  the poll interval is time for which the application was blocked,
+    //  recorded as a stall.
+    //
+    while(!time_reached(deadline)){
+
+        // Check attempts
+        bool connecting = false;
+        bool established = false;
+        for(size_t i = 0; i < LEN(attempts); i++){
+            if(!attempts[i]) continue;
+            if(attempts[i]->state == CONNECTION_CONNECTED){
+                connected = attempts[i];
+                break;
+            }
+            if(attempts[i]->state == CONNECTION_CONNECTING){
+                connecting = true;
+                established = established
+                    || connection_is_established(attempts[i]);
+            }
+        }
+        if(connected) break;
+
+        // Start next attempt
+        //
+        //  To the most preferred address not yet attempted, once resolved;
+        //  addresses which failed to resolve are skipped. Addresses may yet
+        //  be resolving (see resolve_hostname), so are read with lwIP lock
+        //  held.
+        //
+        //  Not whilst an attempt has established its TCP connection (its TLS
+        //  handshake then in progress); the race is decided on TCP, as a
+        //  slow handshake says nothing of the path. Resumed should that
+        //  attempt fail.
+        //
+        if(!established && (!connecting || time_reached(due))){
+            for(size_t i = 0; i < LEN(attempts); i++){
+                if(started[i]) continue;
+                cyw43_arch_lwip_begin();
+                ip_addr_t ipaddr = ipaddrs[i];
+                cyw43_arch_lwip_end();
+                if(ipaddr_is_failed(&ipaddr)){
+                    started[i] = true;
+                    continue;
+                }
+                if(!ipaddr_is_resolved(&ipaddr)) continue;
+                started[i] = true;
+                if(connect_attempt(
+                    &ipaddr,
+                    PICOHTTPS_HOSTNAME,
+                    LWIP_IANA_PORT_HTTPS,
+                    &attempts[i]
+                )){
+                    connecting = true;
+                    due = make_timeout_time_ms(
+                        PICOHTTPS_CONNECTION_ATTEMPT_DELAY
+                    );
+                }
+                break;
+            }
+        }
+
+        // All attempts failed
+        bool pending = false;
+        for(size_t i = 0; i < LEN(started); i++)
+            pending = pending || !started[i];
+        if(!connecting && !pending) break;
+
+        // Await attempts
+        //
+        //  Draining log records meanwhile; a handshake (esp. with Mbed TLS
+        //  debugging) logs more than the buffer holds. Output time is not
+        //  counted as stall.
+        //
+        log_drain();
+        absolute_time_t polled = get_absolute_time();
+        sleep_ms(PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL);
+        int64_t stall = absolute_time_diff_us(polled, get_absolute_time()) / 1000
+            - PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL;
+        cyw43_arch_lwip_begin();
+        if(stall > (int64_t)stats.tls.stall_max)
+            stats.tls.stall_max = (u32_t)stall;
+        cyw43_arch_lwip_end();
+
+    }
+
+    // Free losing attempts
+    //
+    //  Abort handshakes in progress (unless already aborted).
+    //
+    for(size_t i = 0; i < LEN(attempts); i++)
+        if(attempts[i] && attempts[i] != connected)
+            cancel_connection(attempts[i]);
+
+    // Return
+    if(!connected) return false;
+    *pcb = connected->pcb;
+    return true;
+
+}
+
+// Start TCP + TLS connection attempt
+bool connect_attempt(
+    const ip_addr_t* ipaddr,
+    const char* hostname,
+    u16_t port,
+    struct altcp_callback_arg** connection
+){
+
+    // Instantiate connection
+    //
+    //  The callback argument doubles as the connection lifecycle object,
+    //  owning the connection configuration and PCB. On failure at any stage,
+    //  all are released together (disconnect_from_host, cancel_connection).
+    //
+    //  N.b. callback argument must be in scope in callbacks. As callbacks may
+    //  fire after current function returns, cannot declare argument locally,
+    //  but rather should allocate on the heap. Must then ensure allocated
+    //  memory is subsequently freed.
+    //
+    *connection = NULL;
+    struct altcp_callback_arg* arg = malloc(sizeof(*arg));
+    if(!arg) return false;
+    arg->state = CONNECTION_NEW;
+    arg->config = NULL;
+    arg->pcb = NULL;
+    arg->acknowledged = 0;
+    arg->active = get_absolute_time();
+    arg->initiated = nil_time;
+    arg->deadline = nil_time;
+    arg->err = ERR_OK;
+    arg->status = 0;
+    http_response_init(&(arg->response));
+
+    // Instantiate connection configuration
+    //
+    //  CA root certificate is parsed from flash (constant data). With a CA
+    //  bundle, none is parsed up front; trusted CAs are instead looked up
+    //  during chain validation (see below).
+    //
+#ifdef PICOHTTPS_CA_BUNDLE
+    cyw43_arch_lwip_begin();
+    arg->config = altcp_tls_create_config_client(NULL, 0);
+    cyw43_arch_lwip_end();
+#else
+    static const u8_t ca_cert[] = PICOHTTPS_CA_ROOT_CERT;
+    cyw43_arch_lwip_begin();
+    arg->config = altcp_tls_create_config_client(
+        ca_cert,
+        LEN(ca_cert)
+    );
+    cyw43_arch_lwip_end();
+#endif //PICOHTTPS_CA_BUNDLE
+    if(!arg->config){
+        disconnect_from_host(arg);
+        return false;
+    }
+
+    // Instantiate connection PCB
+    //
+    //  Can also do this more generically using;
+    //
+    //    altcp_allocator_t allocator = {
+    //      altcp_tls_alloc,       // Allocator function
+    //      config                 // Allocator function argument (state)
+    //    };
+    //    altcp_new(&allocator);
+    //
+    //  No benefit in doing this though; altcp_tls_alloc calls altcp_tls_new
+    //  under the hood anyway.
+    //
+    cyw43_arch_lwip_begin();
+    arg->pcb = altcp_tls_new(arg->config, IP_GET_TYPE(ipaddr));
+    cyw43_arch_lwip_end();
+    if(!arg->pcb){
+        disconnect_from_host(arg);
+        return false;
+    }
+
+    // Configure hostname for Server Name Indication extension
+    //
+    //  Many servers nowadays require clients to support the [Server Name
+    //  Indication[wiki-sni] (SNI) TLS extension. In this extension, the
+    //  hostname is included in the in the ClientHello section of the TLS
+    //  handshake.
+    //
+    //  Mbed TLS provides client-side support for SNI extension
+    //  (`MBEDTLS_SSL_SERVER_NAME_INDICATION` option), but requires the
+    //  hostname in order to do so. Unfortunately, the Mbed TLS port supplied
+    //  with lwIP (ALTCP TLS) does not currently provide an interface to pass
+    //  the hostname to Mbed TLS. This is a [known issue in lwIP][gh-lwip-pr].
+    //
+    //  As a workaround, the hostname can instead be set using the underlying
+    //  Mbed TLS interface (viz. `mbedtls_ssl_set_hostname` function). This is
+    //  somewhat inelegant as it tightly couples our application code to the
+    //  underlying TLS library (viz. Mbed TLS). Given that the Pico SDK already
+    //  tightly couples us to lwIP though, and that any fix is unlikely to be
+    //  backported to the lwIP version in the Pico SDK, this doesn't feel like
+    //  too much of a crime…
+    //
+    //  [wiki-sni]: https://en.wikipedia.org/wiki/Server_Name_Indication
+    //  [gh-lwip-pr]: https://github.com/lwip-tcpip/lwip/pull/47/commits/c53c9d02036be24a461d2998053a52991e65b78e
+    //
+    cyw43_arch_lwip_begin();
+    mbedtls_err_t mbedtls_err = mbedtls_ssl_set_hostname(
+        &(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context
+        ),
+        hostname
+    );
+    cyw43_arch_lwip_end();
+    if(mbedtls_err){
+        disconnect_from_host(arg);
+        return false;
+    }
+
+    // Resume cached TLS session
+    //
+    //  Abbreviated handshake if server still holds session (or accepts
+    //  ticket); otherwise falls back to full handshake. Cached session is
+    //  copied into the SSL context.
+    //
+    cyw43_arch_lwip_begin();
+    if(tls_session_valid) mbedtls_ssl_set_session(
+        &(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context
+        ),
+        &tls_session
+    );
+    cyw43_arch_lwip_end();
+
+    // Configure TCP keepalive
+    //
+    //  Detects dead (half-open) pooled connections. ALTCP provides no
+    //  keepalive interface (in lwIP 2.1), so configure the underlying TCP PCB
+    //  directly; this is the inner connection of the TLS PCB.
+    //
+    cyw43_arch_lwip_begin();
+    struct tcp_pcb* tcp_pcb = (struct tcp_pcb*)(arg->pcb->inner_conn->state);
+    ip_set_option(tcp_pcb, SOF_KEEPALIVE);
+    tcp_pcb->keep_idle = PICOHTTPS_TCP_KEEPALIVE_IDLE;
+    tcp_pcb->keep_intvl = PICOHTTPS_TCP_KEEPALIVE_INTERVAL;
+    tcp_pcb->keep_cnt = PICOHTTPS_TCP_KEEPALIVE_COUNT;
+    cyw43_arch_lwip_end();
+
+    // Defer server authentication to pinned key check
+    //
+    //  Certificate chain validation (X.509 signature verification up to the
+    //  CA root) dominates client handshake CPU time. With pinning enabled,
+    //  chain validation is disabled for the handshake itself. The server
+    //  certificate is nonetheless parsed, and the server must still prove
+    //  possession of its private key (ServerKeyExchange signature, Finished
+    //  message). The certificate public key is then checked against the
+    //  pinned set in callback_altcp_connect, before any application data is
+    //  sent, falling back to full chain validation on a miss.
+    //
+    //  As above, lwIP provides no interface to the Mbed TLS configuration;
+    //  reach it via the SSL context. Configuration is not shared between
+    //  connections, so this affects this connection only.
+    //
+#ifdef PICOHTTPS_PINNED_KEYS
+    cyw43_arch_lwip_begin();
+    mbedtls_ssl_conf_authmode(
+        (mbedtls_ssl_config*)(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context.conf
+        ),
+        MBEDTLS_SSL_VERIFY_NONE
+    );
+    cyw43_arch_lwip_end();
+#endif //PICOHTTPS_PINNED_KEYS
+
+    // Draw random bytes from pool
+    //
+    //  Pre-generated from the long-lived DRBG (callback_rng), rather than the
+    //  ALTCP TLS port's DRBG.
+    //
+    cyw43_arch_lwip_begin();
+    mbedtls_ssl_conf_rng(
+        (mbedtls_ssl_config*)(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context.conf
+        ),
+        callback_rng,
+        &rng
+    );
+    cyw43_arch_lwip_end();
+
+    // Log Mbed TLS debug messages
+    //
+    //  To the log buffer (callback_mbedtls_debug), replacing the ALTCP TLS
+    //  port's synchronous output (ALTCP_MBEDTLS_LIB_DEBUG), if any.
+    //
+#ifdef MBEDTLS_DEBUG_C
+    cyw43_arch_lwip_begin();
+    mbedtls_ssl_conf_dbg(
+        (mbedtls_ssl_config*)(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context.conf
+        ),
+        callback_mbedtls_debug,
+        NULL
+    );
+    cyw43_arch_lwip_end();
+#endif //MBEDTLS_DEBUG_C
+
+    // Look up trusted CAs in CA bundle
+    //
+    //  Only the issuers of the presented chain are parsed (callback_ca_bundle),
+    //  rather than the whole bundle.
+    //
+#ifdef PICOHTTPS_CA_BUNDLE
+    cyw43_arch_lwip_begin();
+    mbedtls_ssl_conf_ca_cb(
+        (mbedtls_ssl_config*)(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context.conf
+        ),
+        callback_ca_bundle,
+        NULL
+    );
+    cyw43_arch_lwip_end();
+#endif //PICOHTTPS_CA_BUNDLE
+
+    // Prefer X25519 key exchange
+    //
+    //  Offered first for ECDHE. NIST curves are retained for servers not
+    //  supporting X25519, and for verification of ECDSA server certificates
+    //  (the list also restricts acceptable certificate keys). List must
+    //  outlive the configuration.
+    //
+    static const mbedtls_ecp_group_id curves[] = {
+        MBEDTLS_ECP_DP_CURVE25519,
+        MBEDTLS_ECP_DP_SECP256R1,
+        MBEDTLS_ECP_DP_SECP384R1,
+        MBEDTLS_ECP_DP_NONE
+    };
+    cyw43_arch_lwip_begin();
+    mbedtls_ssl_conf_curves(
+        (mbedtls_ssl_config*)(
+            (
+                (altcp_mbedtls_state_t*)(arg->pcb->state)
+            )->ssl_context.conf
+        ),
+        curves
+    );
+    cyw43_arch_lwip_end();
+
+    // Configure common argument for connection callbacks
+    cyw43_arch_lwip_begin();
+    altcp_arg(arg->pcb, (void*)arg);
+    cyw43_arch_lwip_end();
+
+    // Configure connection fatal error callback
+    cyw43_arch_lwip_begin();
+    altcp_err(arg->pcb, callback_altcp_err);
+    cyw43_arch_lwip_end();
+
+    // Configure idle connection callback (and interval)
+    cyw43_arch_lwip_begin();
+    altcp_poll(
+        arg->pcb,
+        callback_altcp_poll,
+        PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL
+    );
+    cyw43_arch_lwip_end();
+
+    // Configure data acknowledge callback
+    cyw43_arch_lwip_begin();
+    altcp_sent(arg->pcb, callback_altcp_sent);
+    cyw43_arch_lwip_end();
+
+    // Configure data reception callback
+    cyw43_arch_lwip_begin();
+    altcp_recv(arg->pcb, callback_altcp_recv);
+    cyw43_arch_lwip_end();
+
+    // Send connection request (SYN)
+    cyw43_arch_lwip_begin();
+    arg->initiated = get_absolute_time();
+    lwip_err_t lwip_err = altcp_connect(
+        arg->pcb,
+        ipaddr,
+        port,
+        callback_altcp_connect
+    );
+    if(lwip_err == ERR_OK) connection_set_state(arg, CONNECTION_CONNECTING);
+    cyw43_arch_lwip_end();
+
+    // Free allocated resources
+    if(lwip_err != ERR_OK){
+        cancel_connection(arg);
+        return false;
+    }
+
+    // Return
+    *connection = arg;
+    return true;
+
+}
+
+// Disconnect TCP + TLS connection with server
+void disconnect_from_host(struct altcp_callback_arg* arg){
+
+    // Close connection
+    //
+    //  Unless PCB already freed (by lwIP on abort) or never instantiated.
+    //  Checked and closed with lwIP lock held, so connection cannot be aborted
+    //  concurrently. Error callback is detached first; should closing fail,
+    //  the PCB is aborted instead (altcp_free_pcb), which must not be
+    //  signalled to callback_altcp_err.
+    //
+    cyw43_arch_lwip_begin();
+    if(arg->state != CONNECTION_ABORTED){
+        if(arg->pcb){
+            altcp_err(arg->pcb, NULL);
+            altcp_free_pcb(arg->pcb);
+        }
+        connection_set_state(arg, CONNECTION_CLOSED);
+    }
+    cyw43_arch_lwip_end();
+
+    // Free connection configuration
+    //
+    //  Only once PCB (the TLS context of which references it) has been freed.
+    //
+    if(arg->config) altcp_free_config(arg->config);
+
+    // Free callback argument
+    connection_set_state(arg, CONNECTION_FREED);
+    altcp_free_arg(arg);
+
+}
+
+// Cancel TCP + TLS connection with server
+void cancel_connection(struct altcp_callback_arg* arg){
+
+    // Abort connection
+    //
+    //  Unless PCB already freed (by lwIP on abort) or never instantiated.
+    //  Error callback is detached first, as for disconnect_from_host.
+    //
+    cyw43_arch_lwip_begin();
+    if(arg->pcb && arg->state != CONNECTION_ABORTED){
+        altcp_err(arg->pcb, NULL);
+        altcp_abort(arg->pcb);
+        connection_set_state(arg, CONNECTION_ABORTED);
+    }
+    cyw43_arch_lwip_end();
+
+    // Free remaining resources
+    disconnect_from_host(arg);
+
+}
+
+// Validate TCP + TLS connection state transition
+bool connection_transition_valid(
+    enum connection_state from,
+    enum connection_state to
+){
+    switch(to){
+        case CONNECTION_CONNECTING:
+            return from == CONNECTION_NEW;
+        case CONNECTION_CONNECTED:
+            return from == CONNECTION_CONNECTING;
+        case CONNECTION_ABORTED:
+        case CONNECTION_CLOSED:
+            return (
+                from == CONNECTION_NEW
+                || from == CONNECTION_CONNECTING
+                || from == CONNECTION_CONNECTED
+            );
+        case CONNECTION_FREED:
+            return from == CONNECTION_ABORTED || from == CONNECTION_CLOSED;
+        default:
+            return false;
+    }
+}
+
+// Set TCP + TLS connection state
+void connection_set_state(
+    struct altcp_callback_arg* arg,
+    enum connection_state state
+){
+    assert(connection_transition_valid(arg->state, state));
+    arg->state = state;
+}
+
+// Check TCP connection establishment
+bool connection_is_established(const struct altcp_callback_arg* arg){
+
+    // Check inner TCP PCB state
+    //
+    //  Only whilst connecting; otherwise the PCB may have been freed (by
+    //  lwIP, on abort). Read with lwIP lock held.
+    //
+    cyw43_arch_lwip_begin();
+    bool established = (
+        arg->state == CONNECTION_CONNECTING
+        && ((struct tcp_pcb*)(arg->pcb->inner_conn->state))->state == ESTABLISHED
+    );
+    cyw43_arch_lwip_end();
+    return established;
+
+}
+
+// Check TCP + TLS connection liveness
+bool connection_is_alive(const struct altcp_callback_arg* arg){
+    return arg->state == CONNECTION_CONNECTED;
+}
+
+// Verify pinned server public key
+bool verify_pinned_key(const mbedtls_x509_crt* crt){
+#ifdef PICOHTTPS_PINNED_KEYS
+
+    static const u8_t pins[][32] = PICOHTTPS_PINNED_KEYS;
+
+    // Check expiry
+    //
+    //  Unset clock (i.e. counting from boot) reads as 1970 and cannot be
+    //  meaningfully compared; assume current.
+    //
+    mbedtls_time_t now = mbedtls_time(NULL);
+    if(now > 946684800 && now > PICOHTTPS_PINNED_KEYS_EXPIRY) return false;
+
+    // Hash SubjectPublicKeyInfo
+    u8_t hash[32];
+    if(mbedtls_sha256_ret(crt->pk_raw.p, crt->pk_raw.len, hash, 0))
+        return false;
+
+    // Match against pins
+    for(size_t i = 0; i < LEN(pins); i++)
+        if(!memcmp(hash, pins[i], LEN(hash))) return true;
+    return false;
+
+#else
+    return false;
+#endif //PICOHTTPS_PINNED_KEYS
+}
+
+// Verify server certificate chain
+bool verify_chain(mbedtls_x509_crt* chain){
+
+    uint32_t flags;
+
+    // Verify chain against CA bundle
+#ifdef PICOHTTPS_CA_BUNDLE
+    mbedtls_err_t mbedtls_err = mbedtls_x509_crt_verify_with_ca_cb(
+        chain,
+        callback_ca_bundle,
+        NULL,
+        &mbedtls_x509_crt_profile_default,
+        PICOHTTPS_HOSTNAME,
+        &flags,
+        NULL,
+        NULL
+    );
+#else
+
+    // Parse CA root certificate
+    static const u8_t ca_cert[] = PICOHTTPS_CA_ROOT_CERT;
+    mbedtls_x509_crt ca;
+    mbedtls_x509_crt_init(&ca);
+    if(mbedtls_x509_crt_parse(&ca, ca_cert, LEN(ca_cert))){
+        mbedtls_x509_crt_free(&ca);
+        return false;
+    }
+
+    // Verify chain
+    mbedtls_err_t mbedtls_err = mbedtls_x509_crt_verify(
+        chain,
+        &ca,
+        NULL,
+        PICOHTTPS_HOSTNAME,
+        &flags,
+        NULL,
+        NULL
+    );
+    mbedtls_x509_crt_free(&ca);
+
+#endif //PICOHTTPS_CA_BUNDLE
+
+    // Return
+    return !((bool)mbedtls_err);
+
+}
+
+// Hash certificate name
+u32_t ca_bundle_hash(const u8_t* name, size_t len){
+    u32_t hash = 0x811c9dc5;
+    for(size_t i = 0; i < len; i++){
+        hash ^= name[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Send HTTP request
+bool send_request(struct altcp_pcb* pcb, absolute_time_t deadline){
+
+    const char request[] = PICOHTTPS_REQUEST;
+
+    // Reset request byte counters
+    cyw43_arch_lwip_begin();
+    stats.request.count++;
+    stats.request.tx = 0;
+    stats.request.rx = 0;
+    cyw43_arch_lwip_end();
+
+    // Send request
+    return send_data(pcb, request, LEN(request) - 1, deadline);
+
+}
+
+// Send data
+bool send_data(
+    struct altcp_pcb* pcb,
+    const void* data,
+    u16_t len,
+    absolute_time_t deadline
+){
+
+    // Connection callback argument
+    //
+    //  Outlives PCB, should connection be aborted whilst awaiting
+    //  acknowledgement.
+    //
+    struct altcp_callback_arg* arg = (struct altcp_callback_arg*)(pcb->arg);
+
+    // Check send buffer and queue length
+    //
+    //  Docs state that altcp_write() returns ERR_MEM on send buffer too small
+    //  _or_ send queue too long. Could either check both before calling
+    //  altcp_write, or just handle returned ERR_MEM — which is preferable?
+    //
+    //if(
+    //  altcp_sndbuf(pcb) < len
+    //  || altcp_sndqueuelen(pcb) > TCP_SND_QUEUELEN
+    //) return -1;
+
+    // Write to send buffer
+    cyw43_arch_lwip_begin();
+    lwip_err_t lwip_err = connection_is_alive(arg)
+        ? altcp_write(pcb, data, len, 0)
+        : ERR_ABRT;
+    if(lwip_err != ERR_OK) arg->err = lwip_err;
+    cyw43_arch_lwip_end();
+
+    // Written to send buffer
+    if(lwip_err == ERR_OK){
+
+        // Output send buffer
+        //
+        //  Acknowledgements accumulate in callback_altcp_sent; data spanning
+        //  several segments may be acknowledged piecewise.
+        //
+        //  Server must begin responding before the request deadline, else
+        //  the connection is evicted (callback_altcp_poll).
+        //
+        cyw43_arch_lwip_begin();
+        arg->acknowledged = 0;
+        arg->status = 0;
+        http_response_init(&(arg->response));
+        arg->deadline = make_timeout_time_ms(PICOHTTPS_HTTP_REQUEST_DEADLINE);
+        lwip_err = altcp_output(pcb);
+        if(lwip_err != ERR_OK) arg->err = lwip_err;
+        cyw43_arch_lwip_end();
+
+        // Send buffer output
+        if(lwip_err == ERR_OK){
+
+            // Await acknowledgement
+            while(
+                arg->acknowledged < len
+                && connection_is_alive(arg)
+                && !time_reached(deadline)
+            )
+                sleep_ms(PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL);
+            if(arg->acknowledged != len) lwip_err = -1;
+
+        }
+
+    }
+
+    // Return
+    return !((bool)lwip_err);
+
+}
+
+// Initialise HTTP request batch
+void batch_init(struct request_batch* batch){
+    batch->len = 0;
+    batch->count = 0;
+    batch->queued = nil_time;
+}
+
+// Queue HTTP request in batch
+bool batch_enqueue(
+    struct request_batch* batch,
+    const char* request,
+    u16_t len
+){
+    if(len > LEN(batch->data) - batch->len) return false;
+    memcpy(batch->data + batch->len, request, len);
+    batch->len += len;
+    if(!(batch->count++)) batch->queued = get_absolute_time();
+    return true;
+}
+
+// Check whether HTTP request batch is due
+bool batch_due(const struct request_batch* batch){
+    if(!batch->count) return false;
+    return (
+        batch->len == LEN(batch->data)
+        || absolute_time_diff_us(batch->queued, get_absolute_time())
+            >= (int64_t)PICOHTTPS_BATCH_MAX_DELAY * 1000
+    );
+}
+
+// Queue templated HTTP request in batch
+bool batch_enqueue_template(
+    struct request_batch* batch,
+    const struct request_segment* segments,
+    size_t count,
+    const struct request_segment* holes
+){
+    size_t len = template_render(
+        batch->data + batch->len,
+        LEN(batch->data) - batch->len,
+        segments,
+        count,
+        holes
+    );
+    if(!len) return false;
+    batch->len += len;
+    if(!(batch->count++)) batch->queued = get_absolute_time();
+    return true;
+}
+
+// Render templated HTTP request
+//
+//  N.b. rendered (gathered) into a single buffer, rather than written
+//  segment-wise to the connection; ALTCP TLS encrypts each altcp_write() into
+//  a separate TLS record, which would cost a record header and MAC per
+//  segment on air.
+//
+size_t template_render(
+    char* buf,
+    size_t size,
+    const struct request_segment* segments,
+    size_t count,
+    const struct request_segment* holes
+){
+    size_t len = 0;
+    for(size_t i = 0; i < 2 * count - 1; i++){
+        const struct request_segment* segment = (i % 2)
+            ? &holes[i / 2]             // Dynamic hole
+            : &segments[i / 2];         // Static segment
+        if(segment->len > size - len) return 0;
+        memcpy(buf + len, segment->data, segment->len);
+        len += segment->len;
+    }
+    return len;
+}
+
+// Format unsigned integer template hole
+struct request_segment template_u32(char* buf, u32_t value){
+    char digits[10];
+    u16_t n = 0;
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while(value);
+    for(u16_t i = 0; i < n; i++) buf[i] = digits[n - 1 - i];
+    return (struct request_segment){ buf, n };
+}
+
+// Initialise CBOR encoder
+void cbor_init(struct cbor_writer* writer, u8_t* buf, size_t size){
+    writer->buf = buf;
+    writer->size = size;
+    writer->len = 0;
+    writer->overflow = false;
+}
+
+// Encode CBOR data item head
+void cbor_head(struct cbor_writer* writer, u8_t major, u32_t value){
+
+    // Argument length
+    //
+    //  Immediate (< 24), or following one, two or four bytes (additional
+    //  information 24, 25 or 26).
+    //
+    u8_t n = value < 24 ? 0 : value <= 0xff ? 1 : value <= 0xffff ? 2 : 4;
+    if((size_t)1 + n > writer->size - writer->len){
+        writer->overflow = true;
+        return;
+    }
+
+    // Initial byte
+    u8_t info = n == 0 ? value : n == 1 ? 24 : n == 2 ? 25 : 26;
+    writer->buf[writer->len++] = (major << 5) | info;
+
+    // Argument (big-endian)
+    while(n--) writer->buf[writer->len++] = value >> (8 * n);
+
+}
+
+// Encode CBOR unsigned integer
+void cbor_uint(struct cbor_writer* writer, u32_t value){
+    cbor_head(writer, 0, value);
+}
+
+// Encode CBOR text string
+void cbor_text(struct cbor_writer* writer, const char* text){
+    size_t len = strlen(text);
+    cbor_head(writer, 3, len);
+    if(writer->overflow) return;
+    if(len > writer->size - writer->len){
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->buf + writer->len, text, len);
+    writer->len += len;
+}
+
+// Encode CBOR array head
+void cbor_array(struct cbor_writer* writer, u32_t count){
+    cbor_head(writer, 4, count);
+}
+
+// Encode CBOR single-precision float
+//
+//  Major type 7, additional information 26, followed by the IEEE 754 binary32
+//  representation.
+//
+void cbor_float(struct cbor_writer* writer, float value){
+    u32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if(5 > writer->size - writer->len){
+        writer->overflow = true;
+        return;
+    }
+    writer->buf[writer->len++] = (7 << 5) | 26;
+    for(int n = 3; n >= 0; n--) writer->buf[writer->len++] = bits >> (8 * n);
+}
+
+// Queue telemetry POST in batch
+bool telemetry_enqueue(
+    struct request_batch* batch,
+    const struct telemetry_record* records,
+    size_t count
+){
+#ifdef PICOHTTPS_TELEMETRY_PATH
+
+    // Encode records
+    u8_t body[PICOHTTPS_TELEMETRY_BUFFER_SIZE];
+    struct cbor_writer writer;
+    cbor_init(&writer, body, LEN(body));
+    cbor_array(&writer, count);
+    for(size_t i = 0; i < count; i++){
+        cbor_array(&writer, 3);
+        cbor_text(&writer, records[i].sensor);
+        cbor_uint(&writer, records[i].time);
+        cbor_float(&writer, records[i].value);
+    }
+    if(writer.overflow) return false;
+
+    // Queue request
+    static const struct request_segment segments[] =
+        PICOHTTPS_TELEMETRY_TEMPLATE;
+    char content_length[10];
+    const struct request_segment holes[] = {
+        template_u32(content_length, writer.len),
+        { (const char*)body, (u16_t)writer.len }
+    };
+    return batch_enqueue_template(batch, segments, LEN(segments), holes);
+
+#else
+    return false;
+#endif //PICOHTTPS_TELEMETRY_PATH
+}
+
+// Send HTTP request batch
+bool send_batch(
+    struct altcp_pcb* pcb,
+    struct request_batch* batch,
+    absolute_time_t deadline
+){
+
+    // Reset request byte counters
+    cyw43_arch_lwip_begin();
+    stats.request.count += batch->count;
+    stats.request.tx = 0;
+    stats.request.rx = 0;
+    cyw43_arch_lwip_end();
+
+    // Send all queued requests in single write
+    //
+    //  Requests are pipelined (HTTP/1.1); responses will be received in
+    //  order over the same connection.
+    //
+    return send_data(pcb, batch->data, batch->len, deadline);
+
+}
+
+// Attach output sink to connection
+void sink_attach(struct output_sink* sink, struct altcp_callback_arg* arg){
+    cyw43_arch_lwip_begin();
+    sink->connection = arg;
+    sink->withheld = 0;
+    cyw43_arch_lwip_end();
+}
+
+// Acknowledge received data to TCP
+void sink_recved(struct output_sink* sink, struct altcp_pcb* pcb, u16_t len){
+#ifdef PICOHTTPS_RECV_FLOW_CONTROL
+
+    // Withhold acknowledgement above high watermark
+    //
+    //  Once withholding, continue to do so until sink_drain() falls below the
+    //  low watermark (hysteresis), so as to advertise window in large steps.
+    //
+    if(
+        sink->withheld
+        || (sink->head - sink->tail) > PICOHTTPS_SINK_HIGH_WATERMARK
+    ){
+        sink->withheld += len;
+        return;
+    }
+
+#endif //PICOHTTPS_RECV_FLOW_CONTROL
+    altcp_recved(pcb, len);
+}
+
+// Write packet buffer chain to output sink
+bool sink_write(struct output_sink* sink, const struct pbuf* buf){
+
+    // Determine length to copy
+    u32_t head = sink->head;
+    u32_t space = LEN(sink->data) - (head - sink->tail);
+    u16_t len = buf->tot_len;
+    if(len > space){
+#ifdef PICOHTTPS_SINK_OVERFLOW_DROP
+        sink->dropped += len - space;
+        len = space;
+#else
+        return false;
+#endif //PICOHTTPS_SINK_OVERFLOW_DROP
+    }
+
+    // Copy (at most two contiguous spans)
+    u32_t offset = head & (LEN(sink->data) - 1);
+    u16_t first = LWIP_MIN(len, LEN(sink->data) - offset);
+    pbuf_copy_partial(buf, sink->data + offset, first, 0);
+    pbuf_copy_partial(buf, sink->data, len - first, first);
+
+    // Publish
+    sink->head = head + len;
+    return true;
+
+}
+
+// Drain output sink
+size_t sink_drain(struct output_sink* sink){
+
+    u32_t tail = sink->tail;
+    u32_t head = sink->head;
+    size_t drained = head - tail;
+    if(!drained) return 0;
+
+    // Write (at most two contiguous spans)
+    u32_t offset = tail & (LEN(sink->data) - 1);
+    size_t first = LWIP_MIN(drained, LEN(sink->data) - offset);
+    fwrite(sink->data + offset, 1, first, stdout);
+    if(drained > first) fwrite(sink->data, 1, drained - first, stdout);
+    fflush(stdout);
+
+    // Release
+    sink->tail = head;
+
+    // Advertise withheld receive window below low watermark
+#ifdef PICOHTTPS_RECV_FLOW_CONTROL
+    cyw43_arch_lwip_begin();
+    if(
+        sink->connection
+        && connection_is_alive(sink->connection)
+        && sink->withheld
+        && (sink->head - sink->tail) <= PICOHTTPS_SINK_LOW_WATERMARK
+    ){
+        while(sink->withheld){
+            u16_t len = LWIP_MIN(sink->withheld, 0xffff);
+            altcp_recved(sink->connection->pcb, len);
+            sink->withheld -= len;
+        }
+    }
+    cyw43_arch_lwip_end();
+#endif //PICOHTTPS_RECV_FLOW_CONTROL
+
+    return drained;
+
+}
+
+// Write log record
+bool log_write(
+    u8_t module,
+    u8_t level,
+    u16_t format,
+    const u32_t* args,
+    size_t argc,
+    const char* text,
+    size_t len
+){
+
+    // Assemble record
+    assert(argc <= PICOHTTPS_LOG_ARGS);
+    len = LWIP_MIN(len, PICOHTTPS_LOG_TEXT_SIZE);
+    struct log_record header = {
+        .time = time_us_32(),
+        .format = format,
+        .module = module,
+        .level = level,
+        .args = argc,
+        .text = len
+    };
+    u32_t record[
+        PICOHTTPS_LOG_RECORD_WORDS(PICOHTTPS_LOG_ARGS, PICOHTTPS_LOG_TEXT_SIZE)
+    ];
+    size_t words = PICOHTTPS_LOG_RECORD_WORDS(argc, len);
+    record[words - 1] = 0;                                  // Padding
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header) / sizeof(u32_t), args, argc * sizeof(u32_t));
+    if(len) memcpy(
+        record + sizeof(header) / sizeof(u32_t) + argc,
+        text,
+        len
+    );
+
+    // Check space
+    u32_t head = logs.head;
+    if(words > LEN(logs.data) - (head - logs.tail)){
+        logs.dropped++;
+        return false;
+    }
+
+    // Copy (word at a time, wrapping)
+    for(size_t i = 0; i < words; i++)
+        logs.data[(head + i) & (LEN(logs.data) - 1)] = record[i];
+
+    // Publish
+    //
+    //  Record must be written before head is advanced over it; the barrier
+    //  keeps the compiler from reordering the stores.
+    //
+    __compiler_memory_barrier();
+    logs.head = head + words;
+    return true;
+
+}
+
+// Drain log buffer
+size_t log_drain(void){
+
+    size_t drained = 0;
+    u32_t tail = logs.tail;
+    while(tail != logs.head){
+        __compiler_memory_barrier();    // Read record only after head
+
+        // Copy out record
+        //
+        //  Header first, for its size.
+        //
+        u32_t record[
+            PICOHTTPS_LOG_RECORD_WORDS(PICOHTTPS_LOG_ARGS, PICOHTTPS_LOG_TEXT_SIZE)
+        ];
+        struct log_record header;
+        size_t words = sizeof(header) / sizeof(u32_t);
+        for(size_t i = 0; i < words; i++)
+            record[i] = logs.data[(tail + i) & (LEN(logs.data) - 1)];
+        memcpy(&header, record, sizeof(header));
+        words = PICOHTTPS_LOG_RECORD_WORDS(header.args, header.text);
+        for(size_t i = sizeof(header) / sizeof(u32_t); i < words; i++)
+            record[i] = logs.data[(tail + i) & (LEN(logs.data) - 1)];
+
+        // Release
+        //
+        //  Record must be read before its space is released to log_write.
+        //
+        tail += words;
+        __compiler_memory_barrier();
+        logs.tail = tail;
+
+        // Decode
+        //
+        //  Unused arguments are passed (as zero) but not consumed.
+        //
+        u32_t args[PICOHTTPS_LOG_ARGS] = { 0 };
+        memcpy(
+            args,
+            record + sizeof(header) / sizeof(u32_t),
+            header.args * sizeof(u32_t)
+        );
+        printf(
+            "[%lu.%06lu] %s: ",
+            (unsigned long)(header.time / 1000000),
+            (unsigned long)(header.time % 1000000),
+            header.module < LEN(log_modules) ? log_modules[header.module] : "?"
+        );
+        if(header.format < LOG_FORMAT_COUNT)
+            printf(log_formats[header.format], args[0], args[1], args[2], args[3]);
+        if(header.text) printf(
+            " %.*s",
+            header.text,
+            (const char*)(record + sizeof(header) / sizeof(u32_t) + header.args)
+        );
+        printf("\n");
+        drained++;
+
+    }
+
+    return drained;
+
+}
+
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+// Record received data in receive trace
+void recv_trace_record(struct recv_trace* trace, const struct pbuf* buf){
+
+    // Check space
+    //
+    //  For whole chain; data, packet buffers, and callback.
+    //
+    u16_t count = 0;
+    for(const struct pbuf* p = buf; p; p = p->next) count++;
+    if(
+        trace->full
+        || buf->tot_len > LEN(trace->data) - trace->len
+        || count > LEN(trace->segments) - trace->segment_count
+        || count > 0xff
+        || trace->chain_count == LEN(trace->chains)
+    ){
+        trace->full = true;
+        return;
+    }
+
+    // Append
+    for(const struct pbuf* p = buf; p; p = p->next)
+        trace->segments[trace->segment_count++] = p->len;
+    trace->chains[trace->chain_count++] = (u8_t)count;
+    pbuf_copy_partial(buf, trace->data + trace->len, buf->tot_len, 0);
+    trace->len += buf->tot_len;
+
+}
+
+// Print receive trace
+void recv_trace_print(const struct recv_trace* trace){
+    printf("recv_trace begin\n");
+    const u8_t* data = trace->data;
+    const u16_t* segment = trace->segments;
+    for(u16_t i = 0; i < trace->chain_count; i++){
+        for(u8_t j = 0; j < trace->chains[i]; j++, segment++){
+            if(j) putchar(' ');
+            for(u16_t k = 0; k < *segment; k++) printf("%02x", *data++);
+        }
+        putchar('\n');
+    }
+    printf("recv_trace end\n");
+}
+#endif //PICOHTTPS_RECV_TRACE_SIZE
+
+// Run receive benchmark
+bool recv_benchmark(void){
+#ifdef PICOHTTPS_RECV_BENCHMARK
 
-    // Instantiate connection configuration
-    u8_t ca_cert[] = PICOHTTPS_CA_ROOT_CERT;
-    cyw43_arch_lwip_begin();
-    struct altcp_tls_config* config = altcp_tls_create_config_client(
-        ca_cert,
-        LEN(ca_cert)
-    );
-    cyw43_arch_lwip_end();
-    if(!config) return false;
+    // Replay with recorded segmentation
+    struct recv_benchmark_result recorded;
+    recv_benchmark_replay(0, &recorded);
 
-    // Instantiate connection PCB
+    // Replay fuzzed
     //
-    //  Can also do this more generically using;
+    //  Results aggregated; times and allocations summed, worst-case callback
+    //  time and heap growth maxima.
     //
-    //    altcp_allocator_t allocator = {
-    //      altcp_tls_alloc,       // Allocator function
-    //      config                 // Allocator function argument (state)
-    //    };
-    //    altcp_new(&allocator);
+    struct recv_benchmark_result fuzzed = { 0 };
+    unsigned int diverged = 0;
+    u32_t seed = PICOHTTPS_RECV_BENCHMARK_SEED;
+    for(unsigned int i = 0; i < PICOHTTPS_RECV_BENCHMARK_FUZZ; i++){
+        struct recv_benchmark_result result;
+        recv_benchmark_replay(recv_benchmark_rand(&seed), &result);
+        fuzzed.bytes += result.bytes;
+        fuzzed.callbacks += result.callbacks;
+        fuzzed.time += result.time;
+        fuzzed.time_max = LWIP_MAX(fuzzed.time_max, result.time_max);
+        fuzzed.heap = LWIP_MAX(fuzzed.heap, result.heap);
+        fuzzed.allocations += result.allocations;
+        if(
+            result.responses != recorded.responses
+            || result.status != recorded.status
+        ) diverged++;
+    }
+
+    // Discard output
+    sink.dropped = 0;
+
+    // Print results
     //
-    //  No benefit in doing this though; altcp_tls_alloc calls altcp_tls_new
-    //  under the hood anyway.
+    //  Time per byte in ns; callbacks are timed in whole us.
     //
-    cyw43_arch_lwip_begin();
-    *pcb = altcp_tls_new(config, IPADDR_TYPE_V4);
-    cyw43_arch_lwip_end();
-    if(!(*pcb)){
-        altcp_free_config(config);
-        return false;
+    const struct recv_benchmark_result* results[] = { &recorded, &fuzzed };
+    const char* names[] = { "recorded", "fuzzed" };
+    for(size_t i = 0; i < LEN(results); i++){
+        if(!results[i]->bytes) continue;
+        printf(
+            "Receive benchmark (%s): %lu bytes, %lu callbacks, "
+            "%lu ns/byte, %lu us worst-case callback, %ld bytes heap growth, "
+            "%lu allocations\n",
+            names[i],
+            (unsigned long)results[i]->bytes,
+            (unsigned long)results[i]->callbacks,
+            (unsigned long)(
+                (uint64_t)results[i]->time * 1000 / results[i]->bytes
+            ),
+            (unsigned long)results[i]->time_max,
+            (long)results[i]->heap,
+            (unsigned long)results[i]->allocations
+        );
     }
+    printf(
+        "Receive benchmark parsed %u response(s), %u of %u fuzzed replays diverged\n",
+        recorded.responses,
+        diverged,
+        PICOHTTPS_RECV_BENCHMARK_FUZZ
+    );
 
-    // Configure hostname for Server Name Indication extension
+    // Return
+    return !diverged;
+
+#else
+    return true;
+#endif //PICOHTTPS_RECV_BENCHMARK
+}
+
+// Replay receive trace
+void recv_benchmark_replay(u32_t seed, struct recv_benchmark_result* result){
+#ifdef PICOHTTPS_RECV_BENCHMARK
+
+    // Trace
     //
-    //  Many servers nowadays require clients to support the [Server Name
-    //  Indication[wiki-sni] (SNI) TLS extension. In this extension, the
-    //  hostname is included in the in the ClientHello section of the TLS
-    //  handshake.
+    //  Constant; remains in flash (XIP), and is replayed in place.
     //
-    //  Mbed TLS provides client-side support for SNI extension
-    //  (`MBEDTLS_SSL_SERVER_NAME_INDICATION` option), but requires the
-    //  hostname in order to do so. Unfortunately, the Mbed TLS port supplied
-    //  with lwIP (ALTCP TLS) does not currently provide an interface to pass
-    //  the hostname to Mbed TLS. This is a [known issue in lwIP][gh-lwip-pr].
+    static const u8_t data[] = PICOHTTPS_RECV_TRACE_DATA;
+    static const u16_t segments[] = PICOHTTPS_RECV_TRACE_LENGTHS;
+    static const u8_t chains[] = PICOHTTPS_RECV_TRACE_CHAINS;
+
+    // Scratch connection
     //
-    //  As a workaround, the hostname can instead be set using the underlying
-    //  Mbed TLS interface (viz. `mbedtls_ssl_set_hostname` function). This is
-    //  somewhat inelegant as it tightly couples our application code to the
-    //  underlying TLS library (viz. Mbed TLS). Given that the Pico SDK already
-    //  tightly couples us to lwIP though, and that any fix is unlikely to be
-    //  backported to the lwIP version in the Pico SDK, this doesn't feel like
-    //  too much of a crime…
+    //  Receives parsing state only; never connected.
     //
-    //  [wiki-sni]: https://en.wikipedia.org/wiki/Server_Name_Indication
-    //  [gh-lwip-pr]: https://github.com/lwip-tcpip/lwip/pull/47/commits/c53c9d02036be24a461d2998053a52991e65b78e
+    struct altcp_callback_arg arg = { 0 };
+    http_response_init(&(arg.response));
+
+    // Heap baseline
+    struct picohttps_stats before;
+    stats_snapshot(&before);
+    u32_t allocations = PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS;
+
+    // Replay
     //
-    cyw43_arch_lwip_begin();
-    mbedtls_err_t mbedtls_err = mbedtls_ssl_set_hostname(
-        &(
-            (
-                (altcp_mbedtls_state_t*)((*pcb)->state)
-            )->ssl_context
-        ),
-        PICOHTTPS_HOSTNAME
-    );
-    cyw43_arch_lwip_end();
-    if(mbedtls_err){
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        return false;
+    //  Packet buffers reference the trace in place (PBUF_REF-like); not
+    //  allocated, so never freed.
+    //
+    *result = (struct recv_benchmark_result){ 0 };
+    struct pbuf pbufs[PICOHTTPS_RECV_TRACE_CHAIN_MAX];
+    u32_t offset = 0;
+    size_t segment = 0;
+    size_t chain = 0;
+    while(offset < LEN(data)){
+
+        // Segment callback
+        //
+        //  As recorded, or pseudo-randomly; 1 to PICOHTTPS_RECV_TRACE_CHAIN_MAX
+        //  packet buffers of 1 to PBUF_POOL_BUFSIZE bytes.
+        //
+        size_t count = seed
+            ? 1 + recv_benchmark_rand(&seed) % LEN(pbufs)
+            : chains[chain++];
+        u16_t tot_len = 0;
+        for(size_t i = 0; i < count; i++){
+            u16_t len = seed
+                ? 1 + recv_benchmark_rand(&seed) % PBUF_POOL_BUFSIZE
+                : segments[segment++];
+            len = LWIP_MIN(len, LEN(data) - offset);
+            pbufs[i] = (struct pbuf){
+                .next = NULL,
+                .payload = (void*)(data + offset),
+                .len = len
+            };
+            if(i) pbufs[i - 1].next = &pbufs[i];
+            offset += len;
+            tot_len += len;
+            if(offset == LEN(data)) count = i + 1;
+        }
+        for(size_t i = count; i--;)
+            pbufs[i].tot_len = pbufs[i].len + (
+                pbufs[i].next ? pbufs[i].next->tot_len : 0
+            );
+
+        // Receive
+        //
+        //  As callback_altcp_recv; output discarded (consumer keeping up).
+        //
+        absolute_time_t start = get_absolute_time();
+        sink_write(&sink, &pbufs[0]);
+        http_response_parse(&arg, &pbufs[0]);
+        u32_t time = absolute_time_diff_us(start, get_absolute_time());
+        sink.tail = sink.head;
+
+        // Record
+        result->bytes += tot_len;
+        result->callbacks++;
+        result->time += time;
+        result->time_max = LWIP_MAX(result->time_max, time);
+
     }
 
-    // Configure common argument for connection callbacks
+    // Heap growth
+    struct picohttps_stats after;
+    stats_snapshot(&after);
+    result->heap = (s32_t)(after.mem.used + after.mbedtls.used)
+        - (s32_t)(before.mem.used + before.mbedtls.used);
+    result->allocations = PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS - allocations;
+
+    // Parsing result
+    result->responses = arg.response.index;
+    result->status = arg.response.status;
+
+    // Reset state
     //
-    //  N.b. callback argument must be in scope in callbacks. As callbacks may
-    //  fire after current function returns, cannot declare argument locally,
-    //  but rather should allocate on the heap. Must then ensure allocated
-    //  memory is subsequently freed.
+    //  A traced WebSocket upgrade (101) is recorded regardless of request.
     //
-    struct altcp_callback_arg* arg = malloc(sizeof(*arg));
-    if(!arg){
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        return false;
-    }
-    arg->config = config;
-    arg->connected = false;
-    cyw43_arch_lwip_begin();
-    altcp_arg(*pcb, (void*)arg);
-    cyw43_arch_lwip_end();
+    websocket.upgraded = false;
+    websocket.open = false;
 
-    // Configure connection fatal error callback
-    cyw43_arch_lwip_begin();
-    altcp_err(*pcb, callback_altcp_err);
-    cyw43_arch_lwip_end();
+#else
+    *result = (struct recv_benchmark_result){ 0 };
+#endif //PICOHTTPS_RECV_BENCHMARK
+}
 
-    // Configure idle connection callback (and interval)
-    cyw43_arch_lwip_begin();
-    altcp_poll(
-        *pcb,
-        callback_altcp_poll,
-        PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL
-    );
-    cyw43_arch_lwip_end();
+// Generate pseudo-random number
+u32_t recv_benchmark_rand(u32_t* state){
+    u32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
 
-    // Configure data acknowledge callback
-    cyw43_arch_lwip_begin();
-    altcp_sent(*pcb, callback_altcp_sent);
-    cyw43_arch_lwip_end();
+// Snapshot runtime statistics
+void stats_snapshot(struct picohttps_stats* snapshot){
 
-    // Configure data reception callback
     cyw43_arch_lwip_begin();
-    altcp_recv(*pcb, callback_altcp_recv);
-    cyw43_arch_lwip_end();
 
-    // Send connection request (SYN)
-    cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = altcp_connect(
-        *pcb,
-        ipaddr,
-        LWIP_IANA_PORT_HTTPS,
-        callback_altcp_connect
-    );
-    cyw43_arch_lwip_end();
+    // Application-maintained counters
+    *snapshot = stats;
 
-    // Connection request sent
-    if(lwip_err == ERR_OK){
+    // lwIP heap
+#if MEM_STATS
+    snapshot->mem.used = lwip_stats.mem.used;
+    snapshot->mem.max = lwip_stats.mem.max;
+    snapshot->mem.err = lwip_stats.mem.err;
+#endif //MEM_STATS
 
-        // Await connection
-        //
-        //  Sucessful connection will be confirmed shortly in
-        //  callback_altcp_connect.
-        //
-        while(!(arg->connected))
-            sleep_ms(PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL);
+    // lwIP memory pools
+#if MEMP_STATS
+    for(int i = 0; i < MEMP_MAX; i++){
+        snapshot->memp[i].name = lwip_stats.memp[i]->name;
+        snapshot->memp[i].avail = lwip_stats.memp[i]->avail;
+        snapshot->memp[i].used = lwip_stats.memp[i]->used;
+        snapshot->memp[i].max = lwip_stats.memp[i]->max;
+        snapshot->memp[i].err = lwip_stats.memp[i]->err;
+    }
+#endif //MEMP_STATS
 
-    } else {
+    // Link layer
+#if LINK_STATS
+    snapshot->link.xmit = lwip_stats.link.xmit;
+    snapshot->link.recv = lwip_stats.link.recv;
+    snapshot->link.drop = lwip_stats.link.drop;
+#endif //LINK_STATS
 
-        // Free allocated resources
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        altcp_free_arg(arg);
+    // TCP
+#if TCP_STATS
+    snapshot->tcp.xmit = lwip_stats.tcp.xmit;
+    snapshot->tcp.recv = lwip_stats.tcp.recv;
+    snapshot->tcp.rexmit = lwip_stats.tcp.rexmit;
+    snapshot->tcp.drop = lwip_stats.tcp.drop;
+#endif //TCP_STATS
 
+    cyw43_arch_lwip_end();
+
+}
+
+// Serialize runtime statistics
+size_t stats_serialize(
+    const struct picohttps_stats* snapshot,
+    char* buf,
+    size_t len
+){
+
+    // Append formatted output to buffer
+    //
+    //  Bail out (returning zero) as soon as output is truncated.
+    //
+    size_t n = 0;
+    int written;
+    #define STATS_APPEND(...)                                               \
+        written = snprintf(buf + n, len - n, __VA_ARGS__);                  \
+        if(written < 0 || (size_t)written >= len - n) return 0;             \
+        n += written;
+
+    STATS_APPEND(
+        "{\"mem\":[%lu,%lu,%lu],\"memp\":{",
+        (unsigned long)snapshot->mem.used,
+        (unsigned long)snapshot->mem.max,
+        (unsigned long)snapshot->mem.err
+    );
+    for(int i = 0; i < MEMP_MAX; i++){
+        STATS_APPEND(
+            "%s\"%s\":[%u,%u,%u,%u]",
+            i ? "," : "",
+            snapshot->memp[i].name ? snapshot->memp[i].name : "",
+            snapshot->memp[i].avail,
+            snapshot->memp[i].used,
+            snapshot->memp[i].max,
+            snapshot->memp[i].err
+        );
     }
+    STATS_APPEND(
+        "},\"link\":[%lu,%lu,%lu],\"tcp\":[%lu,%lu,%lu,%lu]",
+        (unsigned long)snapshot->link.xmit,
+        (unsigned long)snapshot->link.recv,
+        (unsigned long)snapshot->link.drop,
+        (unsigned long)snapshot->tcp.xmit,
+        (unsigned long)snapshot->tcp.recv,
+        (unsigned long)snapshot->tcp.rexmit,
+        (unsigned long)snapshot->tcp.drop
+    );
+    STATS_APPEND(
+        ",\"mbedtls\":[%lu,%lu,%lu,%lu],\"tls\":[%lu,%lu,%lu,%lu,%lu,%lu,%lu]",
+        (unsigned long)snapshot->mbedtls.used,
+        (unsigned long)snapshot->mbedtls.max,
+        (unsigned long)snapshot->mbedtls.count,
+        (unsigned long)snapshot->mbedtls.err,
+        (unsigned long)snapshot->tls.completed,
+        (unsigned long)snapshot->tls.failed,
+        (unsigned long)snapshot->tls.pinned,
+        (unsigned long)snapshot->tls.resumed,
+        (unsigned long)snapshot->tls.time,
+        (unsigned long)snapshot->tls.time_max,
+        (unsigned long)snapshot->tls.stall_max
+    );
+    STATS_APPEND(
+        ",\"request\":[%lu,%lu,%lu,%lu,%lu,%lu,%lu]}",
+        (unsigned long)snapshot->request.count,
+        (unsigned long)snapshot->request.tx,
+        (unsigned long)snapshot->request.rx,
+        (unsigned long)snapshot->request.tx_total,
+        (unsigned long)snapshot->request.rx_total,
+        (unsigned long)snapshot->request.timeout,
+        (unsigned long)snapshot->request.retry
+    );
+
+    #undef STATS_APPEND
 
     // Return
-    return !((bool)lwip_err);
+    return n;
 
 }
 
-// Send HTTP request
-bool send_request(struct altcp_pcb* pcb){
+// Print runtime statistics
+bool stats_print(void){
+    struct picohttps_stats snapshot;
+    char buf[PICOHTTPS_STATS_BUFFER_SIZE];
+    stats_snapshot(&snapshot);
+    if(!stats_serialize(&snapshot, buf, LEN(buf))) return false;
+    printf("%s\n", buf);
+    return true;
+}
 
-    const char request[] = PICOHTTPS_REQUEST;
+// Check whether runtime statistics upload is due
+bool stats_upload_due(void){
+    return (
+        is_nil_time(stats_uploaded)
+        || absolute_time_diff_us(stats_uploaded, get_absolute_time())
+            >= (int64_t)PICOHTTPS_STATS_UPLOAD_INTERVAL * 1000
+    );
+}
 
-    // Check send buffer and queue length
+// Upload runtime statistics
+bool stats_upload(struct altcp_pcb* pcb, absolute_time_t deadline){
+#ifdef PICOHTTPS_STATS_UPLOAD_PATH
+
+    // Serialize snapshot
+    struct picohttps_stats snapshot;
+    char body[PICOHTTPS_STATS_BUFFER_SIZE];
+    stats_snapshot(&snapshot);
+    size_t body_len = stats_serialize(&snapshot, body, LEN(body));
+    if(!body_len) return false;
+
+    // Render request
     //
-    //  Docs state that altcp_write() returns ERR_MEM on send buffer too small
-    //  _or_ send queue too long. Could either check both before calling
-    //  altcp_write, or just handle returned ERR_MEM — which is preferable?
+    //  Static segments copied from flash; only Content-Length formatted.
     //
-    //if(
-    //  altcp_sndbuf(pcb) < (LEN(request) - 1)
-    //  || altcp_sndqueuelen(pcb) > TCP_SND_QUEUELEN
-    //) return -1;
+    static const struct request_segment segments[] =
+        PICOHTTPS_STATS_UPLOAD_TEMPLATE;
+    char content_length[10];
+    const struct request_segment holes[] = {
+        template_u32(content_length, body_len),
+        { body, (u16_t)body_len }
+    };
+    char request[PICOHTTPS_STATS_BUFFER_SIZE + 256];
+    size_t request_len = template_render(
+        request,
+        LEN(request),
+        segments,
+        LEN(segments),
+        holes
+    );
+    if(!request_len) return false;
 
-    // Write to send buffer
+    // Send request
     cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = altcp_write(pcb, request, LEN(request) -1, 0);
+    stats.request.count++;
+    stats.request.tx = 0;
+    stats.request.rx = 0;
     cyw43_arch_lwip_end();
+    if(!send_data(pcb, request, (u16_t)request_len, deadline)) return false;
+    stats_uploaded = get_absolute_time();
 
-    // Written to send buffer
-    if(lwip_err == ERR_OK){
-
-        // Output send buffer
-        ((struct altcp_callback_arg*)(pcb->arg))->acknowledged = 0;
-        cyw43_arch_lwip_begin();
-        lwip_err = altcp_output(pcb);
-        cyw43_arch_lwip_end();
-
-        // Send buffer output
-        if(lwip_err == ERR_OK){
-
-            // Await acknowledgement
-            while(
-                !((struct altcp_callback_arg*)(pcb->arg))->acknowledged
-            ) sleep_ms(PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL);
-            if(
-                ((struct altcp_callback_arg*)(pcb->arg))->acknowledged
-                != (LEN(request) - 1)
-            ) lwip_err = -1;
+    // Await response
+    //
+    //  Responses are matched to requests by position within their batch
+    //  (see http_response_parse); a late response would be taken as the
+    //  first response to the next batch.
+    //
+    struct altcp_callback_arg* arg = (struct altcp_callback_arg*)(pcb->arg);
+    absolute_time_t wait = make_timeout_time_ms(PICOHTTPS_HTTP_RESPONSE_WAIT);
+    while(
+        !arg->response.index
+        && connection_is_alive(arg)
+        && !time_reached(wait)
+        && !time_reached(deadline)
+    )
+        if(!sink_drain(&sink))
+            sleep_ms(PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL);
+    return true;
 
-        }
+#else
+    return false;
+#endif //PICOHTTPS_STATS_UPLOAD_PATH
+}
 
+// Mbed TLS heap allocation (tracked)
+//
+//  Allocation size is stored in a header preceding the returned block, so as
+//  to be available on deallocation. Header is sized to preserve alignment.
+//
+void* stats_mbedtls_calloc(size_t n, size_t size){
+    if(size && n > (SIZE_MAX - sizeof(max_align_t)) / size){
+        stats.mbedtls.err++;
+        return NULL;
     }
+    max_align_t* block = calloc(1, sizeof(*block) + n * size);
+    if(!block){
+        stats.mbedtls.err++;
+        return NULL;
+    }
+    *((size_t*)block) = n * size;
+    stats.mbedtls.used += n * size;
+    if(stats.mbedtls.used > stats.mbedtls.max)
+        stats.mbedtls.max = stats.mbedtls.used;
+    stats.mbedtls.count++;
+    stats.mbedtls.allocs++;
+    return block + 1;
+}
 
-    // Return
-    return !((bool)lwip_err);
-
+// Mbed TLS heap deallocation (tracked)
+void stats_mbedtls_free(void* ptr){
+    if(!ptr) return;
+    max_align_t* block = ((max_align_t*)ptr) - 1;
+    stats.mbedtls.used -= *((size_t*)block);
+    stats.mbedtls.count--;
+    free(block);
 }
 
 // DNS response callback
@@ -412,34 +4642,116 @@ void callback_gethostbyname(
     const ip_addr_t* resolved,
     void* ipaddr
 ){
-    if(resolved) *((ip_addr_t*)ipaddr) = *resolved;         // Successful resolution
-    else ((ip_addr_t*)ipaddr)->addr = IPADDR_NONE;          // Failed resolution
+    if(resolved) ip_addr_copy(*((ip_addr_t*)ipaddr), *resolved);    // Successful resolution
+    else ip_addr_set_ip4_u32((ip_addr_t*)ipaddr, IPADDR_NONE);      // Failed resolution
+}
+
+// Network interface link callback
+void callback_netif_link(struct netif* netif){
+    network.link_up = netif_is_link_up(netif);
+    if(network.link_up && network.ip_up) boot_cache_gateway(netif);
+    PICOHTTPS_LOG(
+        NET,
+        2,
+        NETIF_LINK,
+        (u32_t)(uintptr_t)(network.link_up ? "up" : "down")
+    );
+}
+
+// Network interface status callback
+void callback_netif_status(struct netif* netif){
+    network.ip_up = (
+        netif_is_up(netif)
+        && !ip4_addr_isany_val(*netif_ip4_addr(netif))
+    );
+    if(network.ip_up){
+        network.ip = *netif_ip4_addr(netif);
+        network.netmask = *netif_ip4_netmask(netif);
+        network.gw = *netif_ip4_gw(netif);
+        network.lease_valid = true;
+        boot_cache_gateway(netif);
+    }
+    PICOHTTPS_LOG(
+        NET,
+        2,
+        NETIF_STATUS,
+        (u32_t)(uintptr_t)(network.ip_up ? "up" : "down")
+    );
 }
 
 // TCP + TLS connection error callback
 void callback_altcp_err(void* arg, lwip_err_t err){
 
-    // Print error code
-    printf("Connection error [lwip_err_t err == %d]\n", err);
+    // Log error code
+    PICOHTTPS_LOG(TCP, 1, CONNECTION_ERROR, err);
+
+    // Count failed handshake
+    //
+    //  Cached TLS session (if resumed) may be the cause; discard.
+    //
+    if(((struct altcp_callback_arg*)arg)->state != CONNECTION_CONNECTED){
+        stats.tls.failed++;
+        tls_session_clear();
+    }
 
-    // Free ALTCP TLS config
-    if( ((struct altcp_callback_arg*)arg)->config )
-        altcp_free_config( ((struct altcp_callback_arg*)arg)->config );
+    // Record error
+    ((struct altcp_callback_arg*)arg)->err = err;
 
-    // Free ALTCP callback argument
-    altcp_free_arg((struct altcp_callback_arg*)arg);
+    // Signal abort
+    //
+    //  PCB has already been freed by lwIP. Configuration and callback
+    //  argument are freed by the application (disconnect_from_host), which
+    //  must learn of the abort.
+    //
+    connection_set_state(
+        (struct altcp_callback_arg*)arg,
+        CONNECTION_ABORTED
+    );
 
 }
 
 // TCP + TLS connection idle callback
 lwip_err_t callback_altcp_poll(void* arg, struct altcp_pcb* pcb){
-    // Callback not currently used
-    return ERR_OK;
+
+    struct altcp_callback_arg* connection = (struct altcp_callback_arg*)arg;
+
+    // Request in flight
+    //
+    //  Evict if server has not begun responding by deadline.
+    //
+    if(!is_nil_time(connection->deadline)){
+        if(!time_reached(connection->deadline)) return ERR_OK;
+        PICOHTTPS_LOG(TCP, 1, REQUEST_DEADLINE);
+    }
+
+    // Idle
+    //
+    //  Evict if no activity (incl. handshake progress) within idle timeout.
+    //  Not whilst streaming (or WebSocket open); events may be infrequent,
+    //  and a dead connection is detected by TCP keepalive.
+    //
+    else if(!stream.active && !websocket.open){
+        if(
+            absolute_time_diff_us(connection->active, get_absolute_time())
+            < (int64_t)PICOHTTPS_ALTCP_IDLE_TIMEOUT * 1000
+        ) return ERR_OK;
+        PICOHTTPS_LOG(TCP, 2, IDLE_TIMEOUT);
+    } else {
+        return ERR_OK;
+    }
+
+    // Evict connection
+    altcp_abort(pcb);               // Fires callback_altcp_err
+    return ERR_ABRT;
+
 }
 
 // TCP + TLS data acknowledgement callback
 lwip_err_t callback_altcp_sent(void* arg, struct altcp_pcb* pcb, u16_t len){
-    ((struct altcp_callback_arg*)arg)->acknowledged = len;
+    ((struct altcp_callback_arg*)arg)->acknowledged += len;
+    ((struct altcp_callback_arg*)arg)->active = get_absolute_time();
+    stats.request.tx += len;
+    stats.request.tx_total += len;
     return ERR_OK;
 }
 
@@ -464,24 +4776,48 @@ lwip_err_t callback_altcp_recv(
 
             // Handle packet buffer chain
             //
-            //  * buf->tot_len == buf->len — Last buf in chain
-            //    * && buf->next == NULL — last buf in chain, no packets in queue
-            //    * && buf->next != NULL — last buf in chain, more packets in queue
+            //  Copied to the output sink in bulk; output to stdio from the
+            //  main loop so as not to stall the network stack.
             //
-
             if(buf){
 
-                // Print packet buffer
-                u16_t i;
-                while(buf->len != buf->tot_len){
-                    for(i = 0; i < buf->len; i++) putchar(((char*)buf->payload)[i]);
-                    buf = buf->next;
-                }
-                for(i = 0; i < buf->len; i++) putchar(((char*)buf->payload)[i]);
-                assert(buf->next == NULL);
+                // Queue for output
+                //
+                //  If refused, lwIP (ALTCP TLS) retains the chain and
+                //  redelivers it on further reception or next poll. Do not
+                //  free it. Data dropped (PICOHTTPS_SINK_OVERFLOW_DROP) is
+                //  consumed as usual.
+                //
+                if(buf->tot_len && !sink_write(&sink, buf)) return ERR_MEM;
+
+                // Record in receive trace
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+                recv_trace_record(&trace, buf);
+#endif //PICOHTTPS_RECV_TRACE_SIZE
+
+                // Parse response(s)
+                //
+                //  Delimits pipelined responses; records status, and serves
+                //  the response cache.
+                //
+                http_response_parse((struct altcp_callback_arg*)arg, buf);
+
+                // Record activity
+                //
+                //  Server has begun responding; clear request deadline.
+                //
+                ((struct altcp_callback_arg*)arg)->active = get_absolute_time();
+                ((struct altcp_callback_arg*)arg)->deadline = nil_time;
+
+                // Count received bytes
+                stats.request.rx += head->tot_len;
+                stats.request.rx_total += head->tot_len;
 
                 // Advertise data reception
-                altcp_recved(pcb, head->tot_len);
+                //
+                //  Deferred until drained, under flow control.
+                //
+                sink_recved(&sink, pcb, head->tot_len);
 
             }
 
@@ -508,9 +4844,194 @@ lwip_err_t callback_altcp_connect(
     struct altcp_pcb* pcb,
     lwip_err_t err
 ){
-    ((struct altcp_callback_arg*)arg)->connected = true;
+
+    // Verify pinned server public key
+    //
+    //  Chain validation was skipped during handshake (see connect_to_host).
+    //  Fall back to full validation if key not pinned.
+    //
+#ifdef PICOHTTPS_PINNED_KEYS
+    mbedtls_x509_crt* crt = (mbedtls_x509_crt*)mbedtls_ssl_get_peer_cert(
+        &(((altcp_mbedtls_state_t*)(pcb->state))->ssl_context)
+    );
+    if(crt && verify_pinned_key(crt)){
+        stats.tls.pinned++;
+    } else if(!crt || !verify_chain(crt)){
+        PICOHTTPS_LOG(TLS, 1, VERIFY_FAILED);
+        altcp_abort(pcb);           // Fires callback_altcp_err
+        return ERR_ABRT;
+    }
+#endif //PICOHTTPS_PINNED_KEYS
+
+    connection_set_state(
+        (struct altcp_callback_arg*)arg,
+        CONNECTION_CONNECTED
+    );
+
+    // Record handshake
+    //
+    //  Session was resumed if it carries the cached session's master secret;
+    //  a full handshake derives a fresh one. The session ID cannot be used:
+    //  alongside a session ticket, Mbed TLS sends (and the server echoes) a
+    //  random ID rather than the cached one.
+    //
+    const mbedtls_ssl_context* ssl =
+        &(((altcp_mbedtls_state_t*)(pcb->state))->ssl_context);
+    if(
+        tls_session_valid
+        && ssl->session
+        && !memcmp(
+            ssl->session->master,
+            tls_session.master,
+            sizeof(tls_session.master)
+        )
+    ) stats.tls.resumed++;
+    stats.tls.time = absolute_time_diff_us(
+        ((struct altcp_callback_arg*)arg)->initiated,
+        get_absolute_time()
+    ) / 1000;
+    stats.tls.time_max = LWIP_MAX(stats.tls.time_max, stats.tls.time);
+    stats.tls.completed++;
+    PICOHTTPS_LOG(TCP, 2, CONNECTED, stats.tls.time);
+
+    tls_session_save(ssl);
+    ((struct altcp_callback_arg*)arg)->active = get_absolute_time();
     return ERR_OK;
+
+}
+
+// Trusted CA callback
+int callback_ca_bundle(
+    void* arg,
+    const mbedtls_x509_crt* child,
+    mbedtls_x509_crt** candidates
+){
+
+    *candidates = NULL;
+
+#ifdef PICOHTTPS_CA_BUNDLE
+
+    // Find first entry with issuer's hash
+    //
+    //  Binary search; entries sorted by hash.
+    //
+    u32_t hash = ca_bundle_hash(child->issuer_raw.p, child->issuer_raw.len);
+    size_t lo = 0;
+    size_t hi = LEN(ca_bundle_index);
+    while(lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if(ca_bundle_index[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // Parse matching CA certificates
+    //
+    //  Subject must match issuer exactly (hashes may collide). Parsed in
+    //  place; certificate data is referenced in flash, not copied. Entries
+    //  failing to parse are skipped; no list is returned if none parse.
+    //
+    bool parsed = false;
+    for(
+        const struct ca_bundle_entry* entry = &ca_bundle_index[lo];
+        entry < ca_bundle_index + LEN(ca_bundle_index) && entry->hash == hash;
+        entry++
+    ){
+        const u8_t* der = ca_bundle + entry->offset;
+        if(
+            entry->subject_len != child->issuer_raw.len
+            || memcmp(
+                der + entry->subject_offset,
+                child->issuer_raw.p,
+                entry->subject_len
+            )
+        ) continue;
+        if(!*candidates){
+            *candidates = mbedtls_calloc(1, sizeof(**candidates));
+            if(!*candidates) return MBEDTLS_ERR_X509_ALLOC_FAILED;
+            mbedtls_x509_crt_init(*candidates);
+        }
+        if(!mbedtls_x509_crt_parse_der_nocopy(*candidates, der, entry->len))
+            parsed = true;
+    }
+    if(*candidates && !parsed){
+        mbedtls_x509_crt_free(*candidates);
+        mbedtls_free(*candidates);
+        *candidates = NULL;
+    }
+
+#endif //PICOHTTPS_CA_BUNDLE
+
+    return 0;
+
+}
+
+// Event stream event callback
+void callback_stream_event(const char* type, const char* data, u16_t len){
+    printf("\nEvent (%s, %u bytes)\n", type[0] ? type : "json", len);
+}
+
+// WebSocket message callback
+void callback_websocket_message(u8_t opcode, const u8_t* data, u16_t len){
+    printf(
+        "\nWebSocket message (%s, %u bytes)\n",
+        opcode == WEBSOCKET_OPCODE_TEXT ? "text" : "binary",
+        len
+    );
 }
 
+// Random number generation callback
+int callback_rng(void* arg, unsigned char* output, size_t len){
 
+    struct rng* rng = (struct rng*)arg;
 
+    // Serve from pool
+    //
+    //  Bytes cleared once served.
+    //
+    size_t n = LWIP_MIN(len, rng->len);
+    rng->len -= n;
+    memcpy(output, rng->pool + rng->len, n);
+    memset(rng->pool + rng->len, 0, n);
+    if(n == len) return 0;
+
+    // Generate remainder
+    rng->misses++;
+    return mbedtls_ctr_drbg_random(&(rng->drbg), output + n, len - n);
+
+}
+
+// Mbed TLS debug callback
+void callback_mbedtls_debug(
+    void* arg,
+    int level,
+    const char* file,
+    int line,
+    const char* str
+){
+
+    // Strip source file directory
+    const char* name = strrchr(file, '/');
+    name = name ? name + 1 : file;
+
+    // Strip trailing newline
+    size_t len = strlen(str);
+    if(len && str[len - 1] == '\n') len--;
+
+    // Log
+    //
+    //  Level already filtered by Mbed TLS (mbedtls_debug_set_threshold).
+    //  Source file name is constant, so is passed by reference; message is
+    //  copied.
+    //
+    const u32_t args[] = { (u32_t)(uintptr_t)name, (u32_t)line };
+    log_write(
+        LOG_MODULE_TLS,
+        (u8_t)level,
+        LOG_FORMAT_MBEDTLS,
+        args,
+        LEN(args),
+        str,
+        len
+    );
+
+}
@@ -35,6 +35,36 @@
 //
 #define PICOHTTPS_WIFI_TIMEOUT                      20000           // ms
 
+// Wireless network reconnection attempts
+//
+//  Maximum number of times connectivity is re-established (following link
+//  or DHCP loss) before giving up on queued requests.
+//
+#define PICOHTTPS_RECONNECT_ATTEMPTS                3
+
+// Wireless network reconnection polling interval
+//
+//  Interval with which to poll for link and IP address whilst rejoining
+//  network.
+//
+#define PICOHTTPS_RECONNECT_POLL_INTERVAL           50              // ms
+
+// Wireless power management mode (active)
+//
+//  `pm` argument to cyw43_wifi_pm() whilst requests are in flight. Power
+//  saving disabled for minimum latency during the burst.
+//
+//  https://www.raspberrypi.com/documentation/pico-sdk/networking.html#group_cyw43_driver
+//
+#define PICOHTTPS_WIFI_PM_ACTIVE                    CYW43_NONE_PM
+
+// Wireless power management mode (idle)
+//
+//  `pm` argument to cyw43_wifi_pm() between request bursts. Deepest power
+//  saving mode (PM1); radio only wakes for beacons.
+//
+#define PICOHTTPS_WIFI_PM_IDLE                      CYW43_AGGRESSIVE_PM
+
 // Wireless network password
 //
 //  N.b. _Strongly_ recommend setting this from the environment rather than
@@ -47,225 +77,3250 @@
 // HTTP server hostname
 #define PICOHTTPS_HOSTNAME                          "example.edu"
 
-// DNS response polling interval
+// Boot cache flash offset
+//
+//  Offset (from start of flash) of the sector reserved for caching network
+//  parameters (DHCP lease, gateway hardware address, server IP address)
+//  across boots. Cached parameters are used optimistically at boot, and
+//  validated in the background. Must not overlap the program binary.
+//
+#define PICOHTTPS_BOOT_CACHE_FLASH_OFFSET           (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+// Offline queue flash sectors
+//
+//  Number of flash sectors reserved for queueing requests which could not be
+//  sent (offline queue). Entries are appended as a circular log, spreading
+//  erasure (wear) evenly over the sectors.
+//
+#define PICOHTTPS_OFFLINE_QUEUE_SECTORS             4
+
+// Offline queue flash offset
+//
+//  Offset (from start of flash) of the sectors reserved for the offline
+//  queue; immediately below the boot cache sector. Must not overlap the
+//  program binary.
+//
+#define PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET        \
+    (                                               \
+        PICOHTTPS_BOOT_CACHE_FLASH_OFFSET           \
+        - PICOHTTPS_OFFLINE_QUEUE_SECTORS           \
+        * FLASH_SECTOR_SIZE                         \
+    )
+
+// Offline queue replay limit
+//
+//  Maximum number of queued entries replayed (loaded into a request batch) at
+//  once. Further entries are replayed in subsequent batches.
+//
+#define PICOHTTPS_OFFLINE_QUEUE_REPLAY_MAX          16
+
+// Response cache persistence
+//
+//  Persist cached responses (see PICOHTTPS_CACHE_ENTRIES) to flash, so that
+//  conditional requests may be made from boot. Comment out to cache in RAM
+//  only.
+//
+//#define PICOHTTPS_CACHE_FLASH
+
+// Response cache flash offset
+//
+//  Offset (from start of flash) of the sectors reserved for persisting cached
+//  responses; one sector per entry, immediately below the offline queue. Must
+//  not overlap the program binary.
+//
+#define PICOHTTPS_CACHE_FLASH_OFFSET                \
+    (                                               \
+        PICOHTTPS_OFFLINE_QUEUE_FLASH_OFFSET        \
+        - PICOHTTPS_CACHE_ENTRIES                   \
+        * FLASH_SECTOR_SIZE                         \
+    )
+
+// Download flash size
+//
+//  Size of the flash region reserved for downloaded resources (see
+//  PICOHTTPS_DOWNLOAD_PATH); bounds the size of resource that may be
+//  downloaded. Whole sectors.
+//
+#define PICOHTTPS_DOWNLOAD_FLASH_SIZE               (256 * 1024)    // bytes
+
+// Download flash offset
+//
+//  Offset (from start of flash) of the region reserved for downloaded
+//  resources; immediately below the response cache. Must not overlap the
+//  program binary.
+//
+#define PICOHTTPS_DOWNLOAD_FLASH_OFFSET             \
+    (                                               \
+        PICOHTTPS_CACHE_FLASH_OFFSET                \
+        - PICOHTTPS_DOWNLOAD_FLASH_SIZE             \
+    )
+
+// DNS response polling interval
+//
+//  Interval with which to poll for responses to DNS queries.
+//
+#define PICOHTTPS_RESOLVE_POLL_INTERVAL             100             // ms
+
+// Resolution delay
+//
+//  Time for which the IPv6 (AAAA) query is awaited once the IPv4 (A) query
+//  has been answered, so that IPv6 remains preferred (RFC 8305 section 3).
+//
+#define PICOHTTPS_RESOLUTION_DELAY                  50              // ms
+
+// Certificate authority root certificate
+//
+//  CA certificate used to sign the HTTP server's certificate. DER or PEM
+//  formats (char array representation).
+//
+//  This is most readily obtained via inspection of the server's certificate
+//  chain, e.g. in a browser.
+//
+//  Kept in flash (constant data); not copied to RAM but for parsing. Unused
+//  with PICOHTTPS_CA_BUNDLE.
+//
+#define PICOHTTPS_CA_ROOT_CERT                          \
+{                                                       \
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,     \
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f      \
+}
+//
+//  or
+//
+//#define PICOHTTPS_CA_ROOT_CERT                                       \
+//"-----BEGIN CERTIFICATE-----\n"                                      \
+//"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/\n" \
+//"-----END CERTIFICATE-----\n"
+
+// Certificate authority bundle
+//
+//  Header defining a bundle of many CA certificates (DER; in flash, as
+//  constant data) and its index by subject name hash, in place of
+//  PICOHTTPS_CA_ROOT_CERT. Only the CAs issuing the presented chain are
+//  looked up and parsed (in place), during chain validation.
+//
+//  Generated from a PEM bundle by ca_bundle.py; defined by CMake when the
+//  PICOHTTPS_CA_BUNDLE_PEM environment variable names the bundle (see
+//  CMakeLists.txt).
+//
+//#define PICOHTTPS_CA_BUNDLE                         "ca_bundle.h"
+
+// Pinned server public keys
+//
+//  SHA-256 hashes of the DER-encoded SubjectPublicKeyInfo of trusted server
+//  (leaf) certificates. When defined, certificate chain validation against
+//  PICOHTTPS_CA_ROOT_CERT is skipped during the TLS handshake, and the server
+//  public key is instead checked against this set once the handshake
+//  completes (the server having proven possession of the key). Full chain
+//  validation is only performed if the key is not pinned, or pins have
+//  expired.
+//
+//  Comment out to always perform full chain validation.
+//
+//  Hashes are most readily obtained with OpenSSL, e.g.
+//
+//    openssl x509 -in server.pem -pubkey -noout \
+//      | openssl pkey -pubin -outform der \
+//      | openssl dgst -sha256
+//
+//#define PICOHTTPS_PINNED_KEYS                                     \
+//{                                                                 \
+//    {                                                             \
+//        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,           \
+//        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,           \
+//        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,           \
+//        0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f            \
+//    }                                                             \
+//}
+
+// Pinned server public keys expiry
+//
+//  Time (seconds since Unix epoch) after which pinned keys are no longer
+//  trusted. Only enforced once the wall clock has been set (e.g. by SNTP);
+//  otherwise pins are assumed current.
+//
+#define PICOHTTPS_PINNED_KEYS_EXPIRY                4102444800      // 2100-01-01
+
+// Random byte pool size
+//
+//  Random bytes pre-generated (during idle time) for TLS handshakes, from a
+//  DRBG seeded once at boot. Handshakes only generate random bytes
+//  themselves once the pool is exhausted. A full handshake draws some 100
+//  bytes (client random, ECDHE key, blinding).
+//
+#define PICOHTTPS_RNG_POOL_SIZE                     256             // bytes
+
+// DRBG reseed interval
+//
+//  Minimum interval between reseeds of the DRBG (with fresh entropy), which
+//  take place during idle time rather than during a handshake.
+//
+#define PICOHTTPS_RNG_RESEED_INTERVAL               600000          // ms
+
+// TCP + TLS connection establishment polling interval
+//
+//  Interval with which to poll for establishment of TCP + TLS connection
+//
+#define PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL       100             // ms
+
+// Connection attempt delay
+//
+//  Time after which, should a connection attempt not have completed, an
+//  attempt to the next server address (other address family) is started in
+//  parallel (Happy Eyeballs; RFC 8305 section 5). Attempts otherwise start as
+//  soon as the previous fails.
+//
+#define PICOHTTPS_CONNECTION_ATTEMPT_DELAY          250             // ms
+
+// TCP + TLS idle connection polling interval
+//
+//  Interval with which to poll application (i.e. call registered polling
+//  callback function) when TCP + TLS connection is idle.
+//
+//  The callback function should be registered with altcp_poll(). The polling
+//  interval is given in units of 'coarse grain timer shots'; one shot
+//  corresponds to approximately 500 ms.
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+//
+#define PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL          2               // shots
+
+// TCP + TLS idle connection timeout
+//
+//  Time after which a pooled connection with no activity (and no request in
+//  flight) is evicted by the polling callback (callback_altcp_poll). Should be
+//  shorter than the server's keep-alive timeout, so that connections are
+//  evicted before the server closes them (i.e. before a request could be
+//  issued on a half-closed connection).
+//
+#define PICOHTTPS_ALTCP_IDLE_TIMEOUT                15000           // ms
+
+// TCP keepalive idle time
+//
+//  Time after which keepalive probes are sent on an idle connection, so as to
+//  detect dead (half-open) connections. lwIP default is two hours.
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__lwip__opts__tcp.html
+//
+#define PICOHTTPS_TCP_KEEPALIVE_IDLE                5000            // ms
+
+// TCP keepalive probe interval
+#define PICOHTTPS_TCP_KEEPALIVE_INTERVAL            2000            // ms
+
+// TCP keepalive probe count
+//
+//  Number of unanswered probes after which the connection is aborted.
+//
+#define PICOHTTPS_TCP_KEEPALIVE_COUNT               3
+
+// HTTP user agent
+//
+//  `User-Agent` header value for templated requests.
+//
+#define PICOHTTPS_USER_AGENT                        "picohttps"
+
+// HTTP request
+//
+//  Plain-text HTTP request to send to server
+//
+#define PICOHTTPS_REQUEST                   \
+    "GET / HTTP/1.1\r\n"                    \
+    "Host: " PICOHTTPS_HOSTNAME "\r\n"      \
+    "\r\n"
+
+// Telemetry path
+//
+//  HTTP path on server to which telemetry records (sensor readings) are
+//  POSTed, CBOR encoded (RFC 8949). Comment out to disable telemetry.
+//
+//#define PICOHTTPS_TELEMETRY_PATH                    "/telemetry"
+
+// Telemetry buffer size
+//
+//  Size of buffer into which telemetry records are encoded. Each record
+//  occupies up to 12 bytes plus its sensor name (array head 1, text head 1,
+//  uint32 time up to 5, float32 value 5).
+//
+#define PICOHTTPS_TELEMETRY_BUFFER_SIZE             256             // bytes
+
+// Telemetry request template
+//
+//  As for PICOHTTPS_STATS_UPLOAD_TEMPLATE; holes are filled with the
+//  Content-Length value and the (CBOR) body.
+//
+#define PICOHTTPS_TELEMETRY_TEMPLATE                         \
+    {                                                        \
+        PICOHTTPS_SEGMENT(                                   \
+            "POST " PICOHTTPS_TELEMETRY_PATH " HTTP/1.1\r\n" \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"               \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"       \
+            "Content-Type: application/cbor\r\n"             \
+            "Content-Length: "                               \
+        ),                                                   \
+        PICOHTTPS_SEGMENT("\r\n\r\n"),                       \
+        PICOHTTPS_SEGMENT("")                                \
+    }
+
+// Configuration path
+//
+//  HTTP path on server of a configuration resource, polled with a conditional
+//  request (see PICOHTTPS_CACHE_ENTRIES). Comment out to disable polling.
+//
+//#define PICOHTTPS_CONFIG_PATH                       "/config"
+
+// Response cache entries
+//
+//  Number of resources (keyed by path) for which the most recent response is
+//  cached. Requests for cached resources are made conditional on the cached
+//  response's validators (ETag, Last-Modified); on `304 Not Modified` the
+//  cached body is served instead of being transferred again.
+//
+#define PICOHTTPS_CACHE_ENTRIES                     2
+
+// Response cache path size
+//
+//  Maximum length of a cached resource's path, including terminator.
+//
+#define PICOHTTPS_CACHE_PATH_SIZE                   64              // bytes
+
+// Response cache validator size
+//
+//  Maximum length of a cached response's ETag or Last-Modified value,
+//  including terminator. Responses with longer values are cached without
+//  that validator.
+//
+#define PICOHTTPS_CACHE_VALIDATOR_SIZE              64              // bytes
+
+// Response cache body size
+//
+//  Maximum length of a cached response body. Larger responses (and responses
+//  without a Content-Length) are not cached.
+//
+#define PICOHTTPS_CACHE_BODY_SIZE                   1024            // bytes
+
+// Conditional request template
+//
+//  As for PICOHTTPS_STATS_UPLOAD_TEMPLATE; holes are filled with the path and
+//  the conditional headers (If-None-Match, If-Modified-Since), if any.
+//
+#define PICOHTTPS_CACHE_REQUEST_TEMPLATE                    \
+    {                                                       \
+        PICOHTTPS_SEGMENT("GET "),                          \
+        PICOHTTPS_SEGMENT(                                  \
+            " HTTP/1.1\r\n"                                 \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"              \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"      \
+        ),                                                  \
+        PICOHTTPS_SEGMENT("\r\n")                           \
+    }
+
+// HTTP response line size
+//
+//  Maximum length of a response status or header line retained whilst
+//  parsing responses (see http_response_parse). Longer lines are truncated.
+//
+#define PICOHTTPS_HTTP_LINE_SIZE                    128             // bytes
+
+// Download path
+//
+//  HTTP path on server of a (large) resource to download to flash (at
+//  PICOHTTPS_DOWNLOAD_FLASH_OFFSET), in ranges. Comment out to disable.
+//
+//#define PICOHTTPS_DOWNLOAD_PATH                     "/firmware.bin"
+
+// Download range size
+//
+//  Size of each range requested (HTTP Range header). Each range is received
+//  into RAM, then written to flash; whole sectors.
+//
+#define PICOHTTPS_DOWNLOAD_RANGE_SIZE               FLASH_SECTOR_SIZE   // bytes
+
+// Download pipeline depth
+//
+//  Number of range requests pipelined in each batch (over one keep-alive
+//  connection). Deeper pipelines keep more of the TCP receive window
+//  (TCP_WND, see lwipopts.h) in use, at the cost of one range buffer of RAM
+//  each.
+//
+#define PICOHTTPS_DOWNLOAD_PIPELINE                 4
+
+// Range request template
+//
+//  As for PICOHTTPS_STATS_UPLOAD_TEMPLATE; holes are filled with the path,
+//  the first and last byte offsets of the range, and an If-Range header
+//  (once the resource's ETag is known).
+//
+#define PICOHTTPS_DOWNLOAD_REQUEST_TEMPLATE                 \
+    {                                                       \
+        PICOHTTPS_SEGMENT("GET "),                          \
+        PICOHTTPS_SEGMENT(                                  \
+            " HTTP/1.1\r\n"                                 \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"              \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"      \
+            "Range: bytes="                                 \
+        ),                                                  \
+        PICOHTTPS_SEGMENT("-"),                             \
+        PICOHTTPS_SEGMENT("\r\n"),                          \
+        PICOHTTPS_SEGMENT("\r\n")                           \
+    }
+
+// Event stream path
+//
+//  HTTP path on server of an event stream (Server-Sent Events, or
+//  newline-delimited JSON), subscribed to once queued requests have been
+//  sent. Events are pushed over the held-open connection, rather than
+//  polled. Comment out to disable.
+//
+//#define PICOHTTPS_STREAM_PATH                       "/events"
+
+// Event stream event size
+//
+//  Maximum length of an event's data (or of an NDJSON line). Longer events
+//  are truncated.
+//
+#define PICOHTTPS_STREAM_EVENT_SIZE                 512             // bytes
+
+// Event stream reconnection delay
+//
+//  Delay before resubscribing to the event stream once it ends, unless set
+//  by the server (`retry` field).
+//
+#define PICOHTTPS_STREAM_RETRY                      3000            // ms
+
+// Event stream request template
+//
+//  As for PICOHTTPS_STATS_UPLOAD_TEMPLATE; holes are filled with the path,
+//  and a Last-Event-ID header (on resubscription), so that the server may
+//  resume the stream.
+//
+#define PICOHTTPS_STREAM_REQUEST_TEMPLATE                         \
+    {                                                             \
+        PICOHTTPS_SEGMENT("GET "),                                \
+        PICOHTTPS_SEGMENT(                                        \
+            " HTTP/1.1\r\n"                                       \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"                    \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"            \
+            "Accept: text/event-stream, application/x-ndjson\r\n" \
+            "Cache-Control: no-cache\r\n"                         \
+        ),                                                        \
+        PICOHTTPS_SEGMENT("\r\n")                                 \
+    }
+
+// WebSocket path
+//
+//  HTTP path on server of a WebSocket (RFC 6455) endpoint, connected to once
+//  queued requests have been sent. The upgraded connection carries readings
+//  (binary frames) and server messages both ways, without per-request HTTP
+//  overhead. Not with PICOHTTPS_STREAM_PATH; both hold the connection.
+//  Comment out to disable.
+//
+//#define PICOHTTPS_WEBSOCKET_PATH                    "/ws"
+
+// WebSocket message size
+//
+//  Maximum length of a received message (reassembled from its fragments).
+//  Longer messages are refused, closing the WebSocket (status 1009).
+//
+#define PICOHTTPS_WEBSOCKET_MESSAGE_SIZE            512             // bytes
+
+// WebSocket frame size
+//
+//  Maximum payload length of a sent frame.
+//
+#define PICOHTTPS_WEBSOCKET_FRAME_SIZE              256             // bytes
+
+// WebSocket reading interval
+//
+//  Interval between readings sent over the open WebSocket.
+//
+#define PICOHTTPS_WEBSOCKET_INTERVAL                100             // ms
+
+// WebSocket reconnection delay
+//
+//  Delay before reconnecting once the WebSocket closes.
+//
+#define PICOHTTPS_WEBSOCKET_RETRY                   3000            // ms
+
+// WebSocket request template
+//
+//  As for PICOHTTPS_STATS_UPLOAD_TEMPLATE; holes are filled with the path,
+//  and the (random, base64-encoded) handshake key.
+//
+#define PICOHTTPS_WEBSOCKET_REQUEST_TEMPLATE                \
+    {                                                       \
+        PICOHTTPS_SEGMENT("GET "),                          \
+        PICOHTTPS_SEGMENT(                                  \
+            " HTTP/1.1\r\n"                                 \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"              \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"      \
+            "Upgrade: websocket\r\n"                        \
+            "Connection: Upgrade\r\n"                       \
+            "Sec-WebSocket-Version: 13\r\n"                 \
+            "Sec-WebSocket-Key: "                           \
+        ),                                                  \
+        PICOHTTPS_SEGMENT("\r\n\r\n")                       \
+    }
+
+
+// HTTP request batch buffer size
+//
+//  Capacity of buffer in which outgoing requests are queued for sending in a
+//  single burst (pipelined over a single connection). Whole batch is written
+//  to the TCP send buffer at once, so must not exceed TCP_SND_BUF (see
+//  lwipopts.h).
+//
+#define PICOHTTPS_BATCH_BUFFER_SIZE                 2048            // bytes
+
+// HTTP request batch maximum delay
+//
+//  Maximum time a request may be queued before the batch is due for sending.
+//  Longer delays allow more requests to share each radio wake-up (lower
+//  energy), at the cost of request latency.
+//
+#define PICOHTTPS_BATCH_MAX_DELAY                   30000           // ms
+
+// HTTP request timeout
+//
+//  End-to-end deadline for each attempt to send a request batch, covering all
+//  phases (hostname resolution, connection establishment, sending and
+//  awaiting response). On expiry, the phase in progress is reported and
+//  abandoned, and its resources reclaimed; the connection is aborted.
+//
+//  Bounds worst case latency, e.g. on lost DNS responses or silent servers.
+//
+#define PICOHTTPS_HTTP_REQUEST_TIMEOUT              30000           // ms
+
+// Retry attempts
+//
+//  Maximum number of times a request batch is retried (following failure in a
+//  phase included in PICOHTTPS_RETRY_PHASES) before giving up. Reset once a
+//  batch succeeds. Reconnection to the wireless network is accounted for
+//  separately (PICOHTTPS_RECONNECT_ATTEMPTS).
+//
+#define PICOHTTPS_RETRY_ATTEMPTS                    4
+
+// Retry phases
+//
+//  Request phases (see PICOHTTPS_PHASE_*) in which failure is retried. Once
+//  a batch has been sent, retrying re-sends every request in it; only include
+//  PICOHTTPS_PHASE_RESPONSE (response timeout) if requests are idempotent.
+//
+#define PICOHTTPS_RETRY_PHASES              \
+    (                                       \
+        PICOHTTPS_PHASE_RESOLVE             \
+        | PICOHTTPS_PHASE_CONNECT           \
+        | PICOHTTPS_PHASE_SEND              \
+        | PICOHTTPS_PHASE_STATUS            \
+    )
+
+// Retry HTTP status
+//
+//  Status code of (first) response on which batch is retried, if
+//  PICOHTTPS_PHASE_STATUS included in PICOHTTPS_RETRY_PHASES. Server
+//  signalling temporary overload.
+//
+#define PICOHTTPS_RETRY_HTTP_STATUS                 503
+
+// Retry backoff
+//
+//  Delay before retry _n_ (counting from zero) is drawn uniformly at random
+//  from [0, min(PICOHTTPS_RETRY_BACKOFF_MAX, PICOHTTPS_RETRY_BACKOFF_INITIAL *
+//  2^n)] ("full jitter"), so that devices failing together (e.g. on server
+//  outage) do not retry in lockstep.
+//
+#define PICOHTTPS_RETRY_BACKOFF_INITIAL             1000            // ms
+#define PICOHTTPS_RETRY_BACKOFF_MAX                 32000           // ms
+
+// HTTP request deadline
+//
+//  Time within which the server must begin responding once a request has been
+//  sent. Otherwise, the connection is evicted by the polling callback
+//  (callback_altcp_poll).
+//
+#define PICOHTTPS_HTTP_REQUEST_DEADLINE             10000           // ms
+
+// HTTP response polling interval
+//
+//  Interval with which to poll for HTTP response from server.
+//
+#define PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL       100             // ms
+
+// HTTP response wait
+//
+//  Time for which to await (and output) HTTP response from server.
+//
+#define PICOHTTPS_HTTP_RESPONSE_WAIT                5000            // ms
+
+// Output sink buffer size
+//
+//  Capacity of ring buffer into which received data is copied (in lwIP
+//  callback context), pending output to stdio (from main loop). Must be a
+//  power of two, and no smaller than a pbuf (PBUF_POOL_BUFSIZE) — the unit in
+//  which the TLS layer passes received data to the application.
+//
+#define PICOHTTPS_SINK_BUFFER_SIZE                  4096            // bytes
+
+// Output sink overflow policy
+//
+//  Received data which does not fit in the output sink buffer is either
+//  dropped (counted in `output_sink.dropped`), or, if commented out, refused —
+//  throttling the server until the buffer has drained.
+//
+//#define PICOHTTPS_SINK_OVERFLOW_DROP
+
+// Receive flow control
+//
+//  Advertise receive window only as the output sink is drained, rather than
+//  immediately on reception. Once sink occupancy exceeds the high watermark,
+//  received data is no longer acknowledged to TCP (closing the receive
+//  window) until occupancy has fallen below the low watermark. This paces the
+//  server to the consumer, rather than alternating between overrunning the
+//  (small) lwIP heap and pbuf pools and stalling.
+//
+//  Comment out to advertise receive window immediately on reception.
+//
+#define PICOHTTPS_RECV_FLOW_CONTROL
+
+// Receive flow control high watermark
+#define PICOHTTPS_SINK_HIGH_WATERMARK               (PICOHTTPS_SINK_BUFFER_SIZE / 2)    // bytes
+
+// Receive flow control low watermark
+#define PICOHTTPS_SINK_LOW_WATERMARK                (PICOHTTPS_SINK_BUFFER_SIZE / 4)    // bytes
+
+// Mbed TLS debug levels
+//
+//  Seemingly not defined in Mbed TLS‽
+//
+//  https://github.com/Mbed-TLS/mbedtls/blob/62e79dc913325a18b46aaea554a2836a4e6fc94b/include/mbedtls/debug.h#L141
+//
+#define PICOHTTPS_MBEDTLS_DEBUG_LEVEL               3
+
+// Log buffer size
+//
+//  Capacity of ring buffer into which binary log records are written (in lwIP
+//  callback context), pending decoding and output to stdio (from main loop).
+//  Must be a power of two. Records which do not fit are dropped (counted in
+//  `log_buffer.dropped`).
+//
+#define PICOHTTPS_LOG_BUFFER_SIZE                   2048            // bytes
+
+// Log text size
+//
+//  Maximum length of text carried in a log record (Mbed TLS debug messages,
+//  which Mbed TLS formats itself); longer text is truncated.
+//
+#define PICOHTTPS_LOG_TEXT_SIZE                     64              // bytes
+
+// Log levels
+//
+//  Per module. Records above a module's level are compiled out; their format
+//  strings are not, remaining in the format table (PICOHTTPS_LOG_FORMATS),
+//  which is shared by all levels. Levels as for Mbed TLS debugging; 0 (none),
+//  1 (error), 2 (state change), 3 (informational), 4 (verbose). Mbed TLS
+//  records additionally require MBEDTLS_DEBUG_C.
+//
+#define PICOHTTPS_LOG_LEVEL_NET                     2
+#define PICOHTTPS_LOG_LEVEL_TCP                     2
+#define PICOHTTPS_LOG_LEVEL_TLS                     PICOHTTPS_MBEDTLS_DEBUG_LEVEL
+#define PICOHTTPS_LOG_LEVEL_HTTP                    2
+
+// Receive trace size
+//
+//  Record data received (in lwIP callback context), along with its
+//  segmentation into callbacks and packet buffers, and print it on exit for
+//  recv_trace.py. Recording stops once the trace is full. Comment out to
+//  disable.
+//
+//#define PICOHTTPS_RECV_TRACE_SIZE                   8192            // bytes
+
+// Receive trace packet buffers
+//
+//  Maximum number of packet buffers (and callbacks) recorded.
+//
+#define PICOHTTPS_RECV_TRACE_SEGMENTS               256
+
+// Receive benchmark
+//
+//  Header (generated by recv_trace.py from a printed receive trace) of a
+//  trace replayed through the receive path (output sink, response parser)
+//  at boot, before any request is queued. Reports time per byte, worst-case
+//  time per callback, heap growth and allocations. Also built for the host
+//  (see host/). Comment out to disable.
+//
+//#define PICOHTTPS_RECV_BENCHMARK                    "recv_trace.h"
+
+// Receive benchmark allocation count
+//
+//  Expression giving the number of heap allocations made so far, from which
+//  those made by each replay are counted. On the device, only Mbed TLS
+//  allocations are counted; the host build counts all allocations.
+//
+#ifndef PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS
+#define PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS        (stats.mbedtls.allocs)
+#endif //PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS
+
+// Receive benchmark fuzzing passes
+//
+//  Replays following that with recorded segmentation, each with the data
+//  segmented at pseudo-random (but reproducible) callback and packet buffer
+//  boundaries. Parsing results must match the recorded replay.
+//
+#define PICOHTTPS_RECV_BENCHMARK_FUZZ               16
+
+// Receive benchmark fuzzing seed
+#define PICOHTTPS_RECV_BENCHMARK_SEED               0x70696369
+
+// Runtime statistics buffer size
+//
+//  Size of buffer into which runtime statistics are serialized (compact JSON)
+//  for printing or upload. Must accommodate one entry per lwIP memory pool.
+//
+#define PICOHTTPS_STATS_BUFFER_SIZE                 1024            // bytes
+
+// Runtime statistics upload path
+//
+//  HTTP path on server to which serialized runtime statistics are POSTed.
+//  Comment out to disable upload (statistics are then only printed to
+//  stdout).
+//
+//#define PICOHTTPS_STATS_UPLOAD_PATH                 "/stats"
+
+// Runtime statistics upload request template
+//
+//  Static segments of the upload request (see PICOHTTPS_SEGMENT), assembled
+//  at compile time and flash-resident. Holes between segments are filled at
+//  runtime with, in order; the Content-Length value, and the body.
+//
+#define PICOHTTPS_STATS_UPLOAD_TEMPLATE                         \
+    {                                                           \
+        PICOHTTPS_SEGMENT(                                      \
+            "POST " PICOHTTPS_STATS_UPLOAD_PATH " HTTP/1.1\r\n" \
+            "Host: " PICOHTTPS_HOSTNAME "\r\n"                  \
+            "User-Agent: " PICOHTTPS_USER_AGENT "\r\n"          \
+            "Content-Type: application/json\r\n"                \
+            "Content-Length: "                                  \
+        ),                                                      \
+        PICOHTTPS_SEGMENT("\r\n\r\n"),                          \
+        PICOHTTPS_SEGMENT("")                                   \
+    }
+
+// Runtime statistics upload interval
+//
+//  Minimum interval between successive uploads of runtime statistics.
+//
+#define PICOHTTPS_STATS_UPLOAD_INTERVAL             60000           // ms
+
+
+/* Macros *********************************************************************/
+
+// Array length
+#define LEN(array) (sizeof array)/(sizeof array[0])
+
+// Server address families
+//
+//  Addresses resolved per server; IPv6, then IPv4 (order of preference).
+//
+#define PICOHTTPS_ADDRESS_FAMILIES                  2
+
+// Log record arguments
+//
+//  Maximum number of arguments per log record.
+//
+#define PICOHTTPS_LOG_ARGS                          4
+
+// Log record size
+//
+//  Size of a log record (header, arguments and text) in log buffer words.
+//
+#define PICOHTTPS_LOG_RECORD_WORDS(args, text)                      \
+    (                                                               \
+        sizeof(struct log_record) / sizeof(u32_t)                   \
+        + (args)                                                    \
+        + ((text) + sizeof(u32_t) - 1) / sizeof(u32_t)              \
+    )
+
+// Log record formats
+//
+//  printf() format strings of log records, indexed by `enum log_format`.
+//  Constant, so remain in flash; records carry only the index. Arguments are
+//  passed as 32-bit words, so `%s` must only be used for constant strings.
+//  Any text carried in a record is printed after the formatted arguments.
+//
+#define PICOHTTPS_LOG_FORMATS                                                                \
+    PICOHTTPS_LOG_FORMAT(NETIF_LINK,        "Link %s")                                       \
+    PICOHTTPS_LOG_FORMAT(NETIF_STATUS,      "Interface %s")                                  \
+    PICOHTTPS_LOG_FORMAT(GATEWAY_FAILED,    "Failed to add gateway [lwip_err_t err == %ld]") \
+    PICOHTTPS_LOG_FORMAT(CONNECTED,         "Connected (handshake %lu ms)")                  \
+    PICOHTTPS_LOG_FORMAT(CONNECTION_ERROR,  "Connection error [lwip_err_t err == %ld]")      \
+    PICOHTTPS_LOG_FORMAT(REQUEST_DEADLINE,  "Request deadline exceeded")                     \
+    PICOHTTPS_LOG_FORMAT(IDLE_TIMEOUT,      "Connection idle timeout")                       \
+    PICOHTTPS_LOG_FORMAT(VERIFY_FAILED,     "Server certificate verification failed")        \
+    PICOHTTPS_LOG_FORMAT(RESPONSE,          "Response %lu (status %ld)")                     \
+    PICOHTTPS_LOG_FORMAT(MBEDTLS,           "%s:%lu:")
+
+// Log record
+//
+//  Written to the log buffer if `level` is within the module's level
+//  (PICOHTTPS_LOG_LEVEL_*), otherwise compiled out. Up to PICOHTTPS_LOG_ARGS
+//  arguments, converted to u32_t. Must only be used with lwIP lock held (or
+//  from callbacks).
+//
+//  e.g. PICOHTTPS_LOG(TCP, 1, CONNECTION_ERROR, err);
+//
+#define PICOHTTPS_LOG(module, level, format, ...)                   \
+    do {                                                            \
+        if((level) <= PICOHTTPS_LOG_LEVEL_ ## module){              \
+            const u32_t log_args[] = { 0, ##__VA_ARGS__ };          \
+            log_write(                                              \
+                LOG_MODULE_ ## module,                              \
+                (level),                                            \
+                LOG_FORMAT_ ## format,                              \
+                log_args + 1,                                       \
+                LEN(log_args) - 1,                                  \
+                NULL,                                               \
+                0                                                   \
+            );                                                      \
+        }                                                           \
+    } while(0)
+
+// Request template segment
+//
+//  Initialiser for a `request_segment` from a string literal; length is
+//  computed at compile time.
+//
+#define PICOHTTPS_SEGMENT(literal) { (literal), sizeof(literal) - 1 }
+
+// Boot cache record marker
+#define PICOHTTPS_BOOT_CACHE_MAGIC                  0x48545053      // "HTPS"
+
+// Offline queue entry marker
+#define PICOHTTPS_OFFLINE_QUEUE_MAGIC               0x4f464651      // "OFFQ"
+
+// Response cache entry marker
+#define PICOHTTPS_CACHE_MAGIC                       0x43414348      // "CACH"
+
+// WebSocket handshake GUID (RFC 6455)
+#define PICOHTTPS_WEBSOCKET_GUID                    \
+    "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+// WebSocket frame buffer size
+//
+//  Words; frame header (at most 8 bytes, sent payloads being shorter than
+//  64 KiB) precedes a word-aligned payload, which is masked a word at a time
+//  (see websocket_frame).
+//
+#define PICOHTTPS_WEBSOCKET_FRAME_WORDS             \
+    (2 + (PICOHTTPS_WEBSOCKET_FRAME_SIZE + 3) / 4)
+
+// Offline queue region size
+#define PICOHTTPS_OFFLINE_QUEUE_SIZE                \
+    (PICOHTTPS_OFFLINE_QUEUE_SECTORS * FLASH_SECTOR_SIZE)
+
+// Offline queue entry size
+//
+//  Flash occupied by entry (header and queued requests) of length `len`;
+//  whole pages.
+//
+#define PICOHTTPS_OFFLINE_ENTRY_SIZE(len)                           \
+    (                                                               \
+        (sizeof(struct offline_entry) + (len) + FLASH_PAGE_SIZE - 1) \
+        / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE                         \
+    )
+
+// Request phases
+//
+//  Bit flags, for timeout reporting (request_timed_out) and retry policy
+//  (PICOHTTPS_RETRY_PHASES).
+//
+#define PICOHTTPS_PHASE_RESOLVE                     0x01            // DNS
+#define PICOHTTPS_PHASE_CONNECT                     0x02            // TCP + TLS
+#define PICOHTTPS_PHASE_SEND                        0x04            // Request
+#define PICOHTTPS_PHASE_RESPONSE                    0x08            // Response
+#define PICOHTTPS_PHASE_STATUS                      0x10            // Status
+
+
+
+/* Data structures ************************************************************/
+
+// lwIP errors
+//
+//  typedef here to make source of error code more explicit
+//
+typedef err_t lwip_err_t;
+
+// Mbed TLS errors
+//
+//  typedef here to make source of error code more explicit
+//
+typedef int mbedtls_err_t;
+
+// TCP + TLS connection state
+//
+//  Connection lifecycle. The application owns the connection (callback
+//  argument, configuration and PCB) throughout; lwIP frees the PCB only on
+//  abort (`CONNECTION_ABORTED`). Valid transitions;
+//
+//    NEW --> CONNECTING --> CONNECTED
+//     |          |              |
+//     +----------+--------------+--> ABORTED | CLOSED --> FREED
+//
+//  Checked (debug builds) by connection_set_state().
+//
+enum connection_state{
+    CONNECTION_NEW,                 // Instantiating
+    CONNECTION_CONNECTING,          // Handshake in progress
+    CONNECTION_CONNECTED,           // Handshake complete
+    CONNECTION_ABORTED,             // PCB freed by lwIP (or cancelled)
+    CONNECTION_CLOSED,              // PCB closed by application
+    CONNECTION_FREED                // Callback argument freed
+};
+
+// HTTP response parser state
+//
+//  Position within the (pipelined) response stream.
+//
+enum http_response_state{
+    HTTP_RESPONSE_STATUS,           // Status line
+    HTTP_RESPONSE_HEADERS,          // Header lines
+    HTTP_RESPONSE_BODY,             // Body (Content-Length delimited)
+    HTTP_RESPONSE_CHUNK_SIZE,       // Chunk size line (chunked encoding)
+    HTTP_RESPONSE_CHUNK,            // Chunk data
+    HTTP_RESPONSE_CHUNK_END,        // Line ending chunk data
+    HTTP_RESPONSE_TRAILERS,         // Trailer lines, following last chunk
+    HTTP_RESPONSE_UNDELIMITED,      // Body ends with connection
+    HTTP_RESPONSE_WEBSOCKET         // WebSocket frames (upgraded connection)
+};
+
+// WebSocket frame opcode
+//
+//  RFC 6455 section 5.2.
+//
+enum websocket_opcode{
+    WEBSOCKET_OPCODE_CONTINUATION   = 0x0,  // Subsequent message fragment
+    WEBSOCKET_OPCODE_TEXT           = 0x1,  // Text (UTF-8) message
+    WEBSOCKET_OPCODE_BINARY         = 0x2,  // Binary message
+    WEBSOCKET_OPCODE_CLOSE          = 0x8,  // Close
+    WEBSOCKET_OPCODE_PING           = 0x9,  // Ping
+    WEBSOCKET_OPCODE_PONG           = 0xa   // Pong
+};
+
+// HTTP response parser
+//
+//  Incremental parser run over data as it is received (callback_altcp_recv),
+//  delimiting pipelined responses so that each may be matched to its request.
+//  Only the status, framing, cache validator and download range headers are
+//  interpreted. Bodies are delimited by Content-Length or chunked encoding;
+//  any other body extends to the end of the connection.
+//
+struct http_response{
+
+    // Parser state
+    enum http_response_state state;
+
+    // Index (within batch) of response being parsed
+    u16_t index;
+
+    // Status code of response being parsed
+    int status;
+
+    // Partial status or header line
+    char line[PICOHTTPS_HTTP_LINE_SIZE];
+    u16_t line_len;
+
+    // Content-Length, if present
+    bool length_known;
+    u32_t length;
+
+    // Chunked transfer encoding
+    bool chunked;
+
+    // Body remaining
+    u32_t remaining;                // bytes
+
+    // Response cache slot whose request this response answers, if any
+    struct cache_slot* cache;
+
+    // Body is being captured to response cache slot
+    bool capture;
+
+    // Download range (within batch) this response answers, else -1
+    int range;
+
+    // Response is the event stream
+    bool stream;
+
+    // Response answers the WebSocket upgrade request
+    bool websocket;
+
+};
+
+// TCP connection callback argument
+//
+//  All callbacks associated with lwIP TCP (+ TLS) connections can be passed a
+//  common argument. This is intended to allow application state to be accessed
+//  from within the callback context. The argument should be registered with
+//  altcp_arg().
+//
+//  The following structure is used for this argument in order to supply all
+//  the relevant application state required by the various callbacks.
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+//
+struct altcp_callback_arg{
+
+    // TCP + TLS connection configurtaion
+    //
+    //  Memory allocated to the connection configuration structure needs to be
+    //  freed (with altcp_tls_free_config) on disconnection
+    //  (disconnect_from_host), once the PCB referencing it has been freed.
+    //
+    //  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+    //  https://www.nongnu.org/lwip/2_1_x/group__altcp__tls.html
+    //
+    struct altcp_tls_config* config;
+
+    // TCP + TLS connection state
+    //
+    //  Successful establishment of a connection needs to be signaled to the
+    //  application from the connection connect callback
+    //  (callback_altcp_connect), and abort from the connection error callback
+    //  (callback_altcp_err). Changed only with connection_set_state().
+    //
+    //  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+    //
+    volatile enum connection_state state;
+
+    // Data reception acknowledgement
+    //
+    //  The amount of data acknowledged as received by the server needs to be
+    //  communicated to the application from the connection sent callback
+    //  (callback_altcp_sent) for validatation of successful transmission.
+    //
+    u16_t acknowledged;
+
+    // TCP + TLS connection PCB
+    //
+    //  Only valid (once instantiated) in states preceding
+    //  `CONNECTION_ABORTED` / `CONNECTION_CLOSED`.
+    //
+    struct altcp_pcb* pcb;
+
+    // Last connection activity
+    //
+    //  Time of last establishment, reception or acknowledgement, for idle
+    //  connection eviction in the connection poll callback
+    //  (callback_altcp_poll).
+    //
+    absolute_time_t active;
+
+    // Connection initiation
+    //
+    //  Time connection request (SYN) was sent, for handshake timing.
+    //
+    absolute_time_t initiated;
+
+    // Request deadline
+    //
+    //  Time by which the server must begin responding to the request in
+    //  flight, if any (else `nil_time`).
+    //
+    absolute_time_t deadline;
+
+    // Last error
+    //
+    //  lwIP error from most recent failed write, or passed to the connection
+    //  error callback (callback_altcp_err). For retry decisions.
+    //
+    lwip_err_t err;
+
+    // HTTP response status
+    //
+    //  Status code of first response to the most recent request (batch), or
+    //  zero if not (yet) received.
+    //
+    int status;
+
+    // HTTP response parser
+    //
+    //  Reset on each request (batch) written.
+    //
+    struct http_response response;
+
+};
+
+// Runtime statistics
+//
+//  Compact snapshot of runtime resource usage. Intended for tuning of memory
+//  pool and heap sizes (lwipopts.h, mbedtls_config.h) in the field.
+//
+//  Fields sourced from lwIP are only populated if the corresponding lwIP
+//  statistics options are enabled (MEM_STATS, MEMP_STATS, LINK_STATS,
+//  TCP_STATS; see lwipopts.h). Remaining fields are maintained by the
+//  application.
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__lwip__opts__stats.html
+//
+struct picohttps_stats{
+
+    // lwIP heap usage
+    struct {
+        u32_t used;                 // bytes
+        u32_t max;                  // bytes
+        u32_t err;                  // failed allocations
+    } mem;
+
+    // lwIP memory pool usage
+    //
+    //  One entry per pool, indexed by `memp_t`.
+    //
+    struct {
+        const char* name;
+        u16_t avail;                // elements
+        u16_t used;                 // elements
+        u16_t max;                  // elements
+        u16_t err;                  // failed allocations
+    } memp[MEMP_MAX];
+
+    // Link layer packet counts
+    struct {
+        u32_t xmit;
+        u32_t recv;
+        u32_t drop;
+    } link;
+
+    // TCP segment counts
+    struct {
+        u32_t xmit;
+        u32_t recv;
+        u32_t rexmit;
+        u32_t drop;
+    } tcp;
+
+    // Mbed TLS heap usage
+    //
+    //  Tracked by the allocator installed with init_stats().
+    //
+    struct {
+        u32_t used;                 // bytes
+        u32_t max;                  // bytes
+        u32_t count;                // live allocations
+        u32_t allocs;               // allocations made (cumulative)
+        u32_t err;                  // failed allocations
+    } mbedtls;
+
+    // TLS handshake counts and durations
+    //
+    //  Durations span connection initiation (TCP SYN) to handshake
+    //  completion. Stalls are the longest the application was blocked (by
+    //  handshake processing, chiefly ECC, in lwIP context) during a handshake,
+    //  to within PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL.
+    //
+    struct {
+        u32_t completed;
+        u32_t failed;
+        u32_t pinned;               // server keys verified by pin
+        u32_t resumed;              // abbreviated (session resumed)
+        u32_t time;                 // ms, most recent
+        u32_t time_max;             // ms
+        u32_t stall_max;            // ms
+    } tls;
+
+    // HTTP request byte counts
+    //
+    //  `tx` and `rx` refer to the most recent request only. Totals are
+    //  accumulated over all requests.
+    //
+    struct {
+        u32_t count;
+        u32_t tx;                   // bytes
+        u32_t rx;                   // bytes
+        u32_t tx_total;             // bytes
+        u32_t rx_total;             // bytes
+        u32_t timeout;              // attempts exceeding request timeout
+        u32_t retry;                // attempts retried
+    } request;
+
+};
+
+
+
+// HTTP request template segment
+//
+//  Requests are templated as alternating static segments and dynamic holes;
+//  `count` segments with `count - 1` holes between them. Static segments are
+//  string literals (initialised with PICOHTTPS_SEGMENT), and so reside in
+//  flash. Holes (e.g. Content-Length, authorisation token, query parameters)
+//  are supplied at runtime in the same form.
+//
+struct request_segment{
+
+    // Segment data (not null-terminated)
+    const char* data;
+
+    // Segment length
+    u16_t len;
+
+};
+
+
+
+// CBOR encoder
+//
+//  Streaming encoder (RFC 8949) writing items into a caller-supplied buffer.
+//  Overflow is sticky; checked once encoding is complete.
+//
+struct cbor_writer{
+
+    // Output buffer
+    u8_t* buf;
+
+    // Size of output buffer
+    size_t size;
+
+    // Length of encoded output
+    size_t len;
+
+    // Output buffer overflowed
+    bool overflow;
+
+};
+
+
+
+// Telemetry record
+//
+//  Single sensor reading. Encoded (CBOR) as the array `[sensor, time, value]`,
+//  with value as a single-precision float.
+//
+struct telemetry_record{
+
+    // Sensor name
+    const char* sensor;
+
+    // Time of reading
+    u32_t time;                     // ms since boot
+
+    // Reading
+    float value;
+
+};
+
+
+
+// HTTP request batch
+//
+//  Outgoing requests queued for sending in a single burst. Requests are stored
+//  back-to-back and pipelined over a single connection, so that the radio need
+//  only be woken once per batch.
+//
+struct request_batch{
+
+    // Queued requests
+    char data[PICOHTTPS_BATCH_BUFFER_SIZE];
+
+    // Length of queued requests
+    u16_t len;
+
+    // Number of queued requests
+    u16_t count;
+
+    // Time at which first request was queued
+    absolute_time_t queued;
+
+};
+
+
+
+// Wireless network state
+//
+//  Maintained by the network interface link and status callbacks
+//  (callback_netif_link, callback_netif_status) registered with
+//  supervise_network(). Association parameters are cached on connection in
+//  order to rejoin without scanning.
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__netif.html
+//
+struct network_state{
+
+    // Link state (associated with access point)
+    volatile bool link_up;
+
+    // Interface state (IP address assigned)
+    volatile bool ip_up;
+
+    // Cached access point BSSID and channel
+    bool bssid_valid;
+    u8_t bssid[6];
+    u32_t channel;
+
+    // Cached DHCP lease
+    //
+    //  N.b. lwIP also retains the lease across link loss and, on link
+    //  restoration, confirms it directly (DHCPREQUEST from INIT-REBOOT state)
+    //  rather than repeating address discovery.
+    //
+    bool lease_valid;
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+
+};
+
+
+
+// CA bundle index entry
+//
+//  Locates a CA certificate, and its subject name, within the CA bundle
+//  (PICOHTTPS_CA_BUNDLE). Entries are sorted by subject name hash.
+//
+struct ca_bundle_entry{
+
+    // Subject name hash (see ca_bundle_hash)
+    u32_t hash;
+
+    // Certificate (DER), within bundle
+    u32_t offset;
+    u16_t len;
+
+    // Subject name (DER), within certificate
+    u16_t subject_offset;
+    u16_t subject_len;
+
+};
+
+
+
+// Boot cache
+//
+//  Network parameters persisted to flash (at
+//  PICOHTTPS_BOOT_CACHE_FLASH_OFFSET) so as to skip DHCP, ARP and DNS
+//  exchanges on the first request after boot (e.g. wake from deep sleep).
+//
+struct boot_cache{
+
+    // Record marker
+    u32_t magic;
+
+    // DHCP lease
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+
+    // Gateway hardware address
+    struct eth_addr gw_hwaddr;
+
+    // Server IP address
+    ip_addr_t server;
+
+    // Record checksum (FNV-1a over all preceding fields)
+    u32_t checksum;
+
+};
+
+
+
+// Offline queue entry header
+//
+//  Precedes each entry (one or more queued requests, back-to-back) in the
+//  offline queue flash region. Entries start on a flash page boundary and do
+//  not cross sector boundaries.
+//
+//  Entries are acknowledged in place by reprogramming `state`; flash
+//  programming can only clear bits, so the rest of the page is unchanged.
+//
+struct offline_entry{
+
+    // Entry marker
+    u32_t magic;
+
+    // Sequence number (increasing in order of appending)
+    u32_t seq;
+
+    // Length of queued requests
+    u16_t len;
+
+    // Number of queued requests
+    u16_t count;
+
+    // Entry checksum (FNV-1a over preceding fields and queued requests)
+    u32_t checksum;
+
+    // Entry state
+    //
+    //  All bits set (erased) whilst pending, cleared on acknowledgement.
+    //
+    u32_t state;
+
+};
+
+
+
+// Offline queue
+//
+//  Position of the circular log within the offline queue flash region, and
+//  entries replayed into the current request batch (pending acknowledgement).
+//
+struct offline_queue{
+
+    // Offset (within region) at which next entry is to be appended
+    u32_t head;
+
+    // Sequence number of next entry
+    u32_t seq;
+
+    // Offsets (within region) of replayed entries
+    u32_t replayed[PICOHTTPS_OFFLINE_QUEUE_REPLAY_MAX];
+
+    // Number of replayed entries
+    u16_t replayed_entries;
+
+    // Number of replayed requests
+    u16_t replayed_count;
+
+    // Length of replayed requests (at start of batch)
+    u16_t replayed_len;
+
+};
+
+
+
+// Response cache entry
+//
+//  Most recent response (validators and body) for a single resource. Layout
+//  is also that persisted to flash (PICOHTTPS_CACHE_FLASH), one sector per
+//  entry.
+//
+struct cache_entry{
+
+    // Entry marker
+    //
+    //  PICOHTTPS_CACHE_MAGIC if body is valid, else zero.
+    //
+    u32_t magic;
+
+    // Resource path (null-terminated)
+    char path[PICOHTTPS_CACHE_PATH_SIZE];
+
+    // Validators (null-terminated; empty if absent)
+    char etag[PICOHTTPS_CACHE_VALIDATOR_SIZE];
+    char last_modified[PICOHTTPS_CACHE_VALIDATOR_SIZE];
+
+    // Response body
+    u16_t len;
+    u8_t body[PICOHTTPS_CACHE_BODY_SIZE];
+
+    // Entry checksum (FNV-1a over all preceding fields)
+    u32_t checksum;
+
+};
+
+
+
+// Response cache slot
+//
+//  Cache entry and its runtime state. Updated from lwIP callback context
+//  (http_response_parse) whilst its request is in flight.
+//
+struct cache_slot{
+
+    // Cache entry
+    struct cache_entry entry;
+
+    // Time of last use
+    //
+    //  Least recently used slot is reused for uncached resources.
+    //
+    absolute_time_t used;
+
+    // Index (within batch) of pending request, plus one
+    //
+    //  Zero if no request pending.
+    //
+    u16_t pending;
+
+    // Status code of most recent response
+    //
+    //  `304` if cached body was served (not modified).
+    //
+    int status;
+
+    // Modified since persisted to flash
+    bool dirty;
+
+};
+
+
+
+// Download
+//
+//  Progress of a resource downloaded to flash in ranges. Ranges are
+//  pipelined in batches over the pooled connection, received into RAM
+//  (from lwIP callback context), and written to flash once the batch's
+//  responses have been received. Should the connection (or network) be lost,
+//  the download resumes from the last range written.
+//
+struct download{
+
+    // Resource path, or `NULL` if no download in progress
+    const char* path;
+
+    // Length written to flash (contiguous from start)
+    u32_t offset;                   // bytes
+
+    // Resource length (from Content-Range), or zero if not yet known
+    u32_t length;                   // bytes
+
+    // Resource ETag (null-terminated; empty if unknown)
+    //
+    //  Sent in If-Range, so that a changed resource is returned in full
+    //  (200) rather than spliced. Strong only; weak ETags may not be used
+    //  in If-Range.
+    //
+    char etag[PICOHTTPS_CACHE_VALIDATOR_SIZE];
+
+    // Index (within batch) of first pending range request, plus one
+    //
+    //  Zero if no ranges pending.
+    //
+    u16_t pending;
+
+    // Number of pending range requests
+    u16_t ranges;
+
+    // Length of batch preceding range requests
+    u16_t batch_len;
+
+    // Range buffers
+    //
+    //  Only when downloads are enabled.
+    //
+#ifdef PICOHTTPS_DOWNLOAD_PATH
+    u8_t data[PICOHTTPS_DOWNLOAD_PIPELINE][PICOHTTPS_DOWNLOAD_RANGE_SIZE];
+#endif //PICOHTTPS_DOWNLOAD_PATH
+
+    // Length received into each range buffer
+    u16_t received[PICOHTTPS_DOWNLOAD_PIPELINE];
+
+    // Range received in full
+    bool complete[PICOHTTPS_DOWNLOAD_PIPELINE];
+
+    // Resource changed (or ranges unsupported); restart from beginning
+    bool restart;
+
+    // Range refused (error response)
+    bool failed;
+
+};
+
+
+
+// Event stream callback
+//
+//  Invoked for each event received, from lwIP callback context (see
+//  stream_start).
+//
+//  @param type     Event type (null-terminated; "message" unless set, empty
+//                  for NDJSON)
+//  @param data     Event data (null-terminated)
+//  @param len      Length of event data
+//
+typedef void (*stream_callback_t)(const char* type, const char* data, u16_t len);
+
+// Event stream
+//
+//  Subscription to a long-lived streaming response (text/event-stream or
+//  application/x-ndjson), parsed incrementally as it is received (from lwIP
+//  callback context) and dispatched event by event.
+//
+struct stream{
+
+    // Stream path, or `NULL` if not subscribed
+    const char* path;
+
+    // Event callback
+    stream_callback_t callback;
+
+    // Index (within batch) of pending stream request, plus one
+    //
+    //  Zero if no request pending.
+    //
+    u16_t pending;
+
+    // Stream response being received
+    volatile bool active;
+
+    // Newline-delimited JSON (else Server-Sent Events)
+    bool ndjson;
+
+    // Partial line
+    char line[PICOHTTPS_STREAM_EVENT_SIZE];
+    u16_t line_len;
+
+    // Pending event type (null-terminated; empty if unset)
+    char type[32];
+
+    // Pending event data
+    char data[PICOHTTPS_STREAM_EVENT_SIZE];
+    u16_t data_len;
+
+    // Last event ID (null-terminated; empty if none)
+    char id[PICOHTTPS_CACHE_VALIDATOR_SIZE];
+
+    // Reconnection delay
+    u32_t retry;                    // ms
+
+    // Events dispatched
+    u32_t events;
+
+};
+
+
+
+// WebSocket message callback
+//
+//  Invoked for each (reassembled) message received, from lwIP callback
+//  context (see websocket_start).
+//
+//  @param opcode   WEBSOCKET_OPCODE_TEXT or WEBSOCKET_OPCODE_BINARY
+//  @param data     Message data
+//  @param len      Length of message data
+//
+typedef void (*websocket_callback_t)(u8_t opcode, const u8_t* data, u16_t len);
+
+// WebSocket
+//
+//  Client end of a WebSocket (RFC 6455) over the pooled connection. Frames
+//  are parsed incrementally as they are received (from lwIP callback
+//  context), across packet buffer boundaries; control frames (ping, close)
+//  are answered from that context too.
+//
+struct websocket{
+
+    // Endpoint path, or `NULL` if not connecting
+    const char* path;
+
+    // Message callback
+    websocket_callback_t callback;
+
+    // Index (within batch) of pending upgrade request, plus one
+    //
+    //  Zero if no request pending.
+    //
+    u16_t pending;
+
+    // Handshake key (base64; null-terminated)
+    char key[25];
+
+    // Handshake accepted (Sec-WebSocket-Accept valid)
+    bool accepted;
+
+    // Connection switched protocols (no longer carries HTTP)
+    bool upgraded;
+
+    // WebSocket open
+    volatile bool open;
+
+    // Close frame sent
+    bool closing;
+
+    // Partial frame header
+    u8_t header[14];
+    u8_t header_len;
+
+    // Frame payload being received
+    bool payload;
+    u8_t opcode;
+    bool fin;
+    u32_t remaining;                // bytes
+
+    // Control frame payload
+    u8_t control[125];
+    u8_t control_len;
+
+    // Message being reassembled
+    u8_t message_opcode;
+    u8_t message[PICOHTTPS_WEBSOCKET_MESSAGE_SIZE];
+    u16_t message_len;
+
+    // Last reading sent
+    absolute_time_t sent;
+
+    // Messages received
+    u32_t messages;
+
+};
+
+
+
+// Output sink
+//
+//  Single-producer (lwIP callback context), single-consumer (main loop) ring
+//  buffer decoupling reception of data from its (slow) output over USB stdio.
+//  Indices increase monotonically and are reduced modulo the (power of two)
+//  buffer size on access.
+//
+struct output_sink{
+
+    // Buffered data
+    u8_t data[PICOHTTPS_SINK_BUFFER_SIZE];
+
+    // Write index
+    //
+    //  Only modified by producer (sink_write).
+    //
+    volatile u32_t head;
+
+    // Read index
+    //
+    //  Only modified by consumer (sink_drain).
+    //
+    volatile u32_t tail;
+
+    // Dropped data
+    //
+    //  Only with PICOHTTPS_SINK_OVERFLOW_DROP.
+    //
+    u32_t dropped;                  // bytes
+
+    // Connection from which data is received
+    //
+    //  For deferred receive window advertisement (PICOHTTPS_RECV_FLOW_CONTROL).
+    //
+    struct altcp_callback_arg* connection;
+
+    // Received data not yet acknowledged to TCP
+    //
+    //  Only with PICOHTTPS_RECV_FLOW_CONTROL. Only access with lwIP lock held
+    //  (or from callbacks).
+    //
+    u32_t withheld;                 // bytes
+
+};
+
+
+
+// Log modules
+//
+//  Each with its own compile-time level (PICOHTTPS_LOG_LEVEL_*).
+//
+enum log_module{
+    LOG_MODULE_NET,                 // Wireless network, DNS
+    LOG_MODULE_TCP,                 // TCP + TLS connection lifecycle
+    LOG_MODULE_TLS,                 // Mbed TLS
+    LOG_MODULE_HTTP                 // HTTP responses
+};
+
+
+
+// Log record formats
+//
+//  See PICOHTTPS_LOG_FORMATS.
+//
+enum log_format{
+#define PICOHTTPS_LOG_FORMAT(id, format) LOG_FORMAT_ ## id,
+    PICOHTTPS_LOG_FORMATS
+#undef PICOHTTPS_LOG_FORMAT
+    LOG_FORMAT_COUNT
+};
+
+
+
+// Log record header
+//
+//  Followed in the log buffer by `args` arguments (words), then `text` bytes
+//  of text padded to a whole word.
+//
+struct log_record{
+
+    // Timestamp
+    u32_t time;                     // us
+
+    // Format
+    u16_t format;                   // enum log_format
+
+    // Module
+    u8_t module;                    // enum log_module
+
+    // Level
+    u8_t level;
+
+    // Argument count
+    u8_t args;
+
+    // Text length
+    u8_t text;                      // bytes
+
+    // Padding (to a whole word)
+    u16_t reserved;
+
+};
+
+
+
+// Log buffer
+//
+//  Ring buffer of binary log records, decoupling logging (in lwIP callback
+//  context, incl. the TLS handshake) from formatting and (slow) output over
+//  USB stdio. Single-producer (lwIP callback context, or lwIP lock held),
+//  single-consumer (main loop); no locking. Indices (in words) increase
+//  monotonically and are reduced modulo the (power of two) buffer size on
+//  access; records may wrap around the end of the buffer.
+//
+struct log_buffer{
+
+    // Buffered records
+    u32_t data[PICOHTTPS_LOG_BUFFER_SIZE / sizeof(u32_t)];
+
+    // Write index
+    //
+    //  Only modified by producer (log_write).
+    //
+    volatile u32_t head;            // words
+
+    // Read index
+    //
+    //  Only modified by consumer (log_drain).
+    //
+    volatile u32_t tail;            // words
+
+    // Dropped records
+    u32_t dropped;
+
+};
+
+
+
+// Receive trace
+//
+//  Data received, and its segmentation; packet buffer lengths, and packet
+//  buffers per callback (chain). Recorded from lwIP callback context
+//  (callback_altcp_recv).
+//
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+struct recv_trace{
+
+    // Received data
+    u8_t data[PICOHTTPS_RECV_TRACE_SIZE];
+    u32_t len;                      // bytes
+
+    // Packet buffer lengths
+    u16_t segments[PICOHTTPS_RECV_TRACE_SEGMENTS];
+    u16_t segment_count;
+
+    // Packet buffers per callback
+    u8_t chains[PICOHTTPS_RECV_TRACE_SEGMENTS];
+    u16_t chain_count;
+
+    // Trace full
+    //
+    //  Subsequent callbacks not recorded.
+    //
+    bool full;
+
+};
+#endif //PICOHTTPS_RECV_TRACE_SIZE
+
+
+
+// Receive benchmark result
+//
+//  Of one replay of a receive trace.
+//
+struct recv_benchmark_result{
+
+    // Data replayed
+    u32_t bytes;
+    u32_t callbacks;
+
+    // Time
+    u32_t time;                     // us, total
+    u32_t time_max;                 // us, worst-case callback
+
+    // Heap growth
+    //
+    //  lwIP and Mbed TLS heaps.
+    //
+    s32_t heap;                     // bytes
+
+    // Heap allocations made (see PICOHTTPS_RECV_BENCHMARK_ALLOCATIONS)
+    u32_t allocations;
+
+    // Parsing result
+    //
+    //  Responses delimited, and status of the last.
+    //
+    u16_t responses;
+    int status;
+
+};
+
+
+
+// Random number generation
+//
+//  Long-lived CTR_DRBG and pool of pre-generated random bytes, consumed by
+//  TLS handshakes (callback_rng) in lwIP callback context. Only access with
+//  lwIP lock held (or from callbacks).
+//
+struct rng{
+
+    // Entropy source
+    mbedtls_entropy_context entropy;
+
+    // DRBG
+    mbedtls_ctr_drbg_context drbg;
+    absolute_time_t reseeded;
+
+    // Pre-generated random bytes
+    //
+    //  Consumed from the end.
+    //
+    u8_t pool[PICOHTTPS_RNG_POOL_SIZE];
+    size_t len;                     // bytes
+
+    // Requests not served (wholly) from pool
+    u32_t misses;
+
+    // Anchoring TCP + TLS connection configuration
+    //
+    //  Holds the ALTCP TLS port's own (shared, reference counted) entropy and
+    //  DRBG contexts, which it would otherwise seed afresh with each
+    //  connection's configuration.
+    //
+    struct altcp_tls_config* anchor;
+
+};
+
+
+
+/* Functions ******************************************************************/
+
+// Initialise standard I/O over USB
+//
+//  @return         `true` on success
+//
+bool init_stdio(void);
+
+// Initialise Pico W wireless hardware
+//
+//  @return         `true` on success
+//
+bool init_cyw43(void);
+
+// Initialise runtime statistics
+//
+//  Installs a heap usage tracking allocator for Mbed TLS. Must be called
+//  before any TCP + TLS connection configuration is created.
+//
+//  @return         `true` on success
+//
+bool init_stats(void);
+
+// Initialise random number generation
+//
+//  Seed DRBG (gathering entropy) and fill random byte pool. Must be called
+//  after init_stats(), and before any TCP + TLS connection configuration is
+//  created.
+//
+//  @return         `true` on success
+//
+bool init_rng(void);
+
+// Random number generation idle work
+//
+//  Reseed DRBG if due (PICOHTTPS_RNG_RESEED_INTERVAL), and refill random
+//  byte pool. Should be called from the main loop whilst idle (no handshake
+//  in progress), not from lwIP callback context.
+//
+//  @return         `true` on success
+//
+bool rng_idle(void);
+
+// Free random number generation
+//
+//  Free DRBG, entropy and anchoring configuration, and clear random byte
+//  pool.
+//
+void free_rng(void);
+
+// Connect to wireless network
+//
+//  @return         `true` on success
+//
+bool connect_to_network(void);
+
+// Load boot cache
+//
+//  Read cached network parameters from flash. Must be called before
+//  connect_to_network() for cached parameters to take effect.
+//
+//  @return         `true` if a valid record was found
+//
+bool boot_cache_load(void);
+
+// Apply boot cache
+//
+//  Optimistically configure the cached DHCP lease and gateway hardware
+//  address, so that requests can be sent as soon as the network is joined.
+//  The lease is validated by the DHCP client in the background (DHCPREQUEST
+//  from INIT-REBOOT state) — a NAK reverts to full address discovery.
+//
+//  Applied at most once per boot; called by connect_to_network(). The
+//  gateway hardware address is only added once the interface is up (see
+//  boot_cache_gateway).
+//
+void boot_cache_apply(void);
+
+// Add cached gateway hardware address
+//
+//  Static ARP entry, so that the first request need not await ARP
+//  resolution. Requires a route to the gateway, so only possible once link
+//  and address are up; called from callback_netif_status. Added at most once
+//  per boot, and only if the gateway is unchanged. Must only be called from
+//  lwIP callback context.
+//
+//  @param netif    Pointer to the wireless `netif` structure
+//
+//  @return         `true` if added
+//
+bool boot_cache_gateway(struct netif* netif);
+
+// Resolve hostname from boot cache
+//
+//  Optimistically supply the cached server IP address, whilst validating it
+//  with a DNS query in the background. The query result is persisted by
+//  boot_cache_save() if it differs. Server authenticity is in any case
+//  verified by TLS.
+//
+//  Used at most once per boot; called by resolve_hostname().
+//
+//  @param ipaddr   Pointer to an `ip_addr_t` where the cached IP address
+//                  should be stored.
+//
+//  @return         `true` if a cached address was supplied
+//
+bool boot_cache_resolve(ip_addr_t* ipaddr);
+
+// Boot cache checksum
+//
+//  @param cache    Pointer to a `boot_cache` structure
+//
+//  @return         FNV-1a hash over all fields preceding `checksum`
+//
+u32_t boot_cache_checksum(const struct boot_cache* cache);
+
+// Save boot cache
+//
+//  Persist current network parameters to flash, once validated by a
+//  successful exchange with the server. Flash is only written if parameters
+//  have changed.
+//
+//  @param server   Pointer to an `ip_addr_t` containing the server's IP
+//                  address
+//
+//  @return         `true` on success
+//
+bool boot_cache_save(const ip_addr_t* server);
+
+// Compute offline queue entry checksum
+//
+//  @param entry    Pointer to an `offline_entry` structure
+//  @param data     Pointer to the entry's queued requests
+//
+//  @return         FNV-1a hash over all fields preceding `checksum`, and data
+//
+u32_t offline_queue_checksum(
+    const struct offline_entry* entry,
+    const void* data
+);
+
+// Get offline queue entry
+//
+//  @param offset   Offset (within region) of a flash page
+//
+//  @return         Pointer to (memory-mapped) entry header at `offset`, or
+//                  `NULL` if no valid entry starts there
+//
+const struct offline_entry* offline_queue_entry(u32_t offset);
+
+// Load offline queue
+//
+//  Scan offline queue flash region to locate head of log.
+//
+//  @return         Number of pending (unacknowledged) entries
+//
+unsigned int offline_queue_load(void);
+
+// Check offline queue flash erased
+//
+//  @param offset   Offset (within region) of start of range
+//  @param size     Size of range
+//
+//  @return         `true` if all bytes in range are erased (0xff)
+//
+bool offline_queue_erased(u32_t offset, u32_t size);
+
+// Append to offline queue
+//
+//  Erases the next sector on entering it, unless it holds pending entries
+//  (queue full).
+//
+//  @param data     Pointer to requests to be queued (back-to-back)
+//  @param len      Length of requests
+//  @param count    Number of requests
+//
+//  @return         `true` on success
+//
+bool offline_queue_append(const char* data, u16_t len, u16_t count);
+
+// Persist request batch to offline queue
+//
+//  Append requests queued in batch, excluding any replayed from the offline
+//  queue (still pending there).
+//
+//  @param batch    Pointer to a `request_batch` structure
+//
+//  @return         `true` on success (or nothing to persist)
+//
+bool offline_queue_persist(const struct request_batch* batch);
+
+// Replay offline queue
+//
+//  Load pending entries, oldest first, into an (empty) request batch, up to
+//  PICOHTTPS_OFFLINE_QUEUE_REPLAY_MAX entries or batch capacity.
+//
+//  @param batch    Pointer to an empty `request_batch` structure
+//
+//  @return         Number of requests replayed
+//
+u16_t offline_queue_replay(struct request_batch* batch);
+
+// Acknowledge replayed offline queue entries
+//
+//  Mark entries replayed into the (now sent) batch as acknowledged, then
+//  compact queue.
+//
+void offline_queue_ack(void);
+
+// Compact offline queue
+//
+//  Erase sectors in which all entries have been acknowledged, other than that
+//  containing the head of the log (from which the head is located at boot).
+//
+void offline_queue_compact(void);
+
+// Compute response cache entry checksum
+//
+//  @param entry    Pointer to a `cache_entry` structure
+//
+//  @return         FNV-1a hash of all fields preceding `checksum`
+//
+u32_t cache_checksum(const struct cache_entry* entry);
+
+// Load response cache
+//
+//  Initialise response cache, loading persisted entries from flash (with
+//  PICOHTTPS_CACHE_FLASH).
+//
+//  @return         Number of entries loaded
+//
+unsigned int cache_load(void);
+
+// Find response cache slot
+//
+//  @param path     Resource path
+//  @param create   Claim a slot (empty or least recently used) if the
+//                  resource is not cached
+//
+//  @return         Pointer to the resource's slot, or `NULL` if not found
+//                  (or path too long)
+//
+struct cache_slot* cache_find(const char* path, bool create);
+
+// Look up cached response
+//
+//  @param path     Resource path
+//
+//  @return         Pointer to the resource's slot, or `NULL` if no valid
+//                  response is cached
+//
+const struct cache_slot* cache_lookup(const char* path);
+
+// Queue conditional HTTP request in batch
+//
+//  GET request for `path`, conditional on the validators of its cached
+//  response (if any). The response (body, or `304 Not Modified`) is matched
+//  to the cache slot by its position in the batch.
+//
+//  @param batch    Pointer to a `request_batch` structure
+//  @param path     Resource path
+//
+//  @return         `true` on success
+//
+bool cache_enqueue(struct request_batch* batch, const char* path);
+
+// Invalidate response cache entry
+//
+//  @param slot     Pointer to a `cache_slot` structure
+//
+void cache_invalidate(struct cache_slot* slot);
+
+// Release response cache slots
+//
+//  Once all responses to a batch have been received (or abandoned); clear
+//  pending requests and persist modified entries (PICOHTTPS_CACHE_FLASH).
+//
+void cache_release(void);
+
+// Persist response cache entry
+//
+//  @param slot     Pointer to a `cache_slot` structure
+//
+//  @return         `true` on success
+//
+bool cache_persist(struct cache_slot* slot);
+
+// Start download
+//
+//  Download resource to flash (at PICOHTTPS_DOWNLOAD_FLASH_OFFSET), in
+//  ranges queued with download_enqueue().
+//
+//  @param path     Resource path
+//
+void download_start(const char* path);
+
+// Queue download range requests in batch
+//
+//  Up to PICOHTTPS_DOWNLOAD_PIPELINE ranges following the last written.
+//  Must be queued last in the batch (see download_dequeue).
+//
+//  @param batch    Pointer to a `request_batch` structure
+//
+//  @return         Number of ranges queued
+//
+u16_t download_enqueue(struct request_batch* batch);
+
+// Remove download range requests from batch
+//
+//  E.g. before storing the batch offline; ranges are re-requested on
+//  resumption instead.
+//
+//  @param batch    Pointer to a `request_batch` structure
+//
+void download_dequeue(struct request_batch* batch);
+
+// Parse Content-Range header
+//
+//  Validates a range response against its request and records the resource
+//  length. Called from lwIP callback context (http_response_line).
+//
+//  @param value    Content-Range header value ("bytes first-last/length")
+//  @param range    Download range (within batch) of the response
+//
+//  @return         `true` if the response holds the requested range
+//
+bool download_content_range(const char* value, int range);
+
+// Write received download ranges
+//
+//  Once the batch's responses have been received (or abandoned). Ranges
+//  received in full are written to flash, contiguously from the last
+//  written; any others are re-requested.
+//
+//  @return         `true` unless the download has failed (range refused,
+//                  ranges unsupported, or resource too large); not
+//                  necessarily complete
+//
+bool download_commit(void);
+
+// Subscribe to event stream
+//
+//  Stream request is queued with stream_enqueue().
+//
+//  @param path     Stream path
+//  @param callback Event callback
+//
+void stream_start(const char* path, stream_callback_t callback);
+
+// Queue event stream request in batch
+//
+//  Resumes from the last event received (Last-Event-ID), if any. Must be
+//  queued last in the batch; the response does not end.
+//
+//  @param batch    Pointer to a `request_batch` structure
+//
+//  @return         `true` on success
+//
+bool stream_enqueue(struct request_batch* batch);
+
+// Parse event stream data
+//
+//  Called from lwIP callback context (http_response_body).
+//
+//  @param data     Pointer to stream data
+//  @param len      Length of stream data
+//
+void stream_parse(const u8_t* data, u16_t len);
+
+// Handle event stream line
+//
+//  Interpret a complete line (`stream.line`); accumulate Server-Sent Events
+//  fields, dispatching on a blank line, or dispatch an NDJSON line.
+//
+void stream_line(void);
+
+// Dispatch event stream event
+void stream_dispatch(void);
+
+// Connect WebSocket
+//
+//  Upgrade request is queued with websocket_enqueue().
+//
+//  @param path     Endpoint path
+//  @param callback Message callback
+//
+void websocket_start(const char* path, websocket_callback_t callback);
+
+// Queue WebSocket upgrade request in batch
+//
+//  With a fresh handshake key. Must be queued last in the batch; the
+//  connection no longer carries HTTP once upgraded.
+//
+//  @param batch    Pointer to a `request_batch` structure
+//
+//  @return         `true` on success
+//
+bool websocket_enqueue(struct request_batch* batch);
+
+// Validate WebSocket handshake
+//
+//  Sec-WebSocket-Accept must be the base64-encoded SHA-1 hash of the
+//  handshake key and GUID.
+//
+//  @param value    Sec-WebSocket-Accept header value
+//
+//  @return         `true` if valid
+//
+bool websocket_accept(const char* value);
+
+// Parse WebSocket data
+//
+//  Called from lwIP callback context (http_response_parse). Frames may span
+//  packet buffers; the header is accumulated, and payload consumed in bulk.
+//
+//  @param arg      Connection callback argument
+//  @param data     Pointer to received data
+//  @param len      Length of received data
+//
+void websocket_parse(
+    struct altcp_callback_arg* arg,
+    const u8_t* data,
+    u16_t len
+);
+
+// Handle received WebSocket frame
+//
+//  Once its payload has been received. Dispatches complete messages, and
+//  answers ping and close frames (lwIP callback context).
+//
+//  @param arg      Connection callback argument
+//
+void websocket_frame_received(struct altcp_callback_arg* arg);
+
+// Close WebSocket
+//
+//  Send close frame (once), and stop parsing frames. The connection is then
+//  discarded by the application. Call from lwIP callback context.
+//
+//  @param arg      Connection callback argument
+//  @param code     Close status code (RFC 6455 section 7.4)
+//
+void websocket_close(struct altcp_callback_arg* arg, u16_t code);
+
+// Mask WebSocket payload
+//
+//  A word at a time, then any trailing bytes. Masking key bytes apply in
+//  memory order, so the key is used as stored in the frame header.
+//
+//  @param data     Pointer to payload (word-aligned)
+//  @param len      Length of payload
+//  @param mask     Masking key
+//
+void websocket_mask(u8_t* data, u16_t len, u32_t mask);
+
+// Build WebSocket frame
+//
+//  Single (final) client frame, masked with a random key. Payload is copied
+//  to a word boundary of `buf` and the header built immediately before it.
+//
+//  @param buf      Frame buffer (PICOHTTPS_WEBSOCKET_FRAME_WORDS words)
+//  @param opcode   Frame opcode
+//  @param data     Pointer to payload
+//  @param len      Length of payload (at most PICOHTTPS_WEBSOCKET_FRAME_SIZE)
+//  @param frame    Receives pointer to start of frame within `buf`
+//
+//  @return         Length of frame
+//
+u16_t websocket_frame(
+    u32_t* buf,
+    u8_t opcode,
+    const void* data,
+    u16_t len,
+    const u8_t** frame
+);
+
+// Write WebSocket frame
+//
+//  Written and output without awaiting acknowledgement. Call with lwIP lock
+//  held, or from lwIP callback context.
+//
+//  @param pcb      Pointer to an `altcp_pcb` structure
+//  @param opcode   Frame opcode
+//  @param data     Pointer to payload
+//  @param len      Length of payload
+//
+//  @return         `true` on success
+//
+bool websocket_write(
+    struct altcp_pcb* pcb,
+    u8_t opcode,
+    const void* data,
+    u16_t len
+);
+
+// Send WebSocket message
+//
+//  As websocket_write, from the application (takes lwIP lock). Failure (e.g.
+//  send buffer full) is recorded on the connection.
+//
+//  @param pcb      Pointer to an `altcp_pcb` structure
+//  @param opcode   WEBSOCKET_OPCODE_TEXT or WEBSOCKET_OPCODE_BINARY
+//  @param data     Pointer to message data
+//  @param len      Length of message data
+//
+//  @return         `true` on success
+//
+bool websocket_send(
+    struct altcp_pcb* pcb,
+    u8_t opcode,
+    const void* data,
+    u16_t len
+);
+
+// Send WebSocket reading
+//
+//  Once PICOHTTPS_WEBSOCKET_INTERVAL has elapsed since the last. Example
+//  reading (received signal strength) encoded as a telemetry record (CBOR).
+//
+//  @param pcb      Pointer to an `altcp_pcb` structure
+//
+//  @return         `true` unless sending failed
+//
+bool websocket_poll(struct altcp_pcb* pcb);
+
+// Supervise wireless network connection
+//
+//  Register network interface link and status callbacks, and cache
+//  association parameters (BSSID, channel) and DHCP lease for fast
+//  reconnection. Must be called after connect_to_network().
+//
+//  @return         `true` on success
+//
+bool supervise_network(void);
+
+// Check wireless network connectivity
+//
+//  @return         `true` if link is up and an IP address is assigned
+//
+bool network_is_up(void);
+
+// Reconnect to wireless network
+//
+//  Rejoin network following link or DHCP loss, without reinitialising the
+//  wireless hardware. The cached BSSID and channel are used to skip scanning;
+//  on failure, falls back to a full join (as connect_to_network()).
+//
+//  @return         `true` on success
+//
+bool reconnect_to_network(void);
+
+// Set wireless power management mode
+//
+//  @param pm       `pm` argument to cyw43_wifi_pm() (e.g.
+//                  PICOHTTPS_WIFI_PM_ACTIVE, PICOHTTPS_WIFI_PM_IDLE)
+//
+//  @return         `true` on success
+//
+bool set_wifi_power_mode(u32_t pm);
+
+// Name request phase
+//
+//  @param phase    Request phase (PICOHTTPS_PHASE_*)
+//
+//  @return         Phase name (e.g. "resolve")
+//
+const char* request_phase_name(u8_t phase);
+
+// Check request deadline
+//
+//  Report expiry of request deadline, naming the phase in progress.
+//
+//  @param deadline Request deadline
+//  @param phase    Phase in progress (PICOHTTPS_PHASE_*)
+//
+//  @return         `true` if deadline has been reached
+//
+bool request_timed_out(absolute_time_t deadline, u8_t phase);
+
+// Compute retry backoff
+//
+//  Exponential backoff with full jitter (see PICOHTTPS_RETRY_BACKOFF_*).
+//
+//  @param attempt  Number of retries already made
+//
+//  @return         Delay before next retry
+//
+u32_t retry_backoff(unsigned int attempt);
+
+// Await retry
+//
+//  If failure in `phase` is to be retried (see PICOHTTPS_RETRY_PHASES) and
+//  attempts remain, sleep for the backoff delay with the wireless hardware in
+//  power saving mode.
+//
+//  @param attempts Pointer to number of retries already made, incremented on
+//                  retry
+//  @param phase    Phase which failed (PICOHTTPS_PHASE_*)
+//
+//  @return         `true` if request should be retried
+//
+bool retry_wait(unsigned int* attempts, u8_t phase);
+
+// Initialise HTTP response parser
+//
+//  Expect first response to a newly written request (batch).
+//
+//  @param response Pointer to an `http_response` structure to initialise
+//
+void http_response_init(struct http_response* response);
+
+// Parse HTTP response data
+//
+//  Delimit pipelined responses, recording the status of the first in
+//  `arg->status` and passing responses to cached requests to the response
+//  cache. Called from lwIP callback context (callback_altcp_recv).
+//
+//  @param arg      Pointer to the connection's callback argument
+//  @param buf      Pointer to a `pbuf` chain of received data
+//
+void http_response_parse(
+    struct altcp_callback_arg* arg,
+    const struct pbuf* buf
+);
+
+// Handle HTTP response line
+//
+//  Interpret a complete status or header line (`arg->response.line`).
+//
+//  @param arg      Pointer to the connection's callback argument
+//
+void http_response_line(struct altcp_callback_arg* arg);
+
+// Handle HTTP response body data
+//
+//  Pass body data to its consumer; the response cache, a download range, or
+//  the event stream.
+//
+//  @param response Pointer to an `http_response` structure
+//  @param data     Pointer to body data
+//  @param len      Length of body data
+//
+void http_response_body(
+    struct http_response* response,
+    const u8_t* data,
+    u16_t len
+);
+
+// Complete HTTP response
+//
+//  Commit a captured body to the response cache, and expect the next
+//  pipelined response.
+//
+//  @param response Pointer to an `http_response` structure
+//
+void http_response_complete(struct http_response* response);
+
+// Match HTTP header
+//
+//  Header names are matched case-insensitively.
+//
+//  @param line     Null-terminated header line
+//  @param name     Header name
+//
+//  @return         Pointer to the header value (leading whitespace skipped)
+//                  or `NULL` if the header is not `name`
+//
+const char* http_header_value(const char* line, const char* name);
+
+// Save TLS session
+//
+//  Cache session parameters of an established connection, for resumption (in
+//  connect_to_host) on subsequent connections. Abbreviated handshake avoids
+//  key exchange and certificate transfer.
+//
+//  @param ssl      Pointer to the connection's `mbedtls_ssl_context`
+//
+void tls_session_save(const mbedtls_ssl_context* ssl);
+
+// Clear TLS session
+//
+//  Discard cached session parameters (e.g. following failed handshake).
+//
+void tls_session_clear(void);
+
+// Resolve hostname
+//
+//  IPv6 (AAAA) and IPv4 (A) addresses are queried in parallel (dual-stack).
+//  Returns once the IPv6 address resolves, or once the IPv4 address has and
+//  the resolution delay (PICOHTTPS_RESOLUTION_DELAY) has passed, or once
+//  both have failed. A cached address (boot cache) is supplied alone.
+//
+//  Each address is zero whilst pending, and marked (see ipaddr_is_failed)
+//  should it fail to resolve.
+//
+//  N.b. DNS queries are not cancelled on return; lwIP times them out
+//  independently, and the callback may still write to `ipaddrs` meanwhile
+//  (e.g. IPv6 resolving after IPv4). Such late results are used by
+//  connect_to_host, as they arrive.
+//
+//  @param ipaddrs  Array of PICOHTTPS_ADDRESS_FAMILIES `ip_addr_t` where the
+//                  resolved IP addresses should be stored, in order of
+//                  preference.
+//  @param deadline Time by which resolution must complete
+//
+//  @return         `true` if any address resolved
+//
+bool resolve_hostname(ip_addr_t* ipaddrs, absolute_time_t deadline);
+
+// Check hostname resolution
+//
+//  @param ipaddr   Pointer to an `ip_addr_t` written by resolve_hostname()
+//
+//  @return         `true` if resolved (neither pending nor failed)
+//
+bool ipaddr_is_resolved(const ip_addr_t* ipaddr);
+
+// Check hostname resolution failure
+//
+//  Failure is marked by the IPv4 broadcast address (IPADDR_NONE), set by
+//  callback_gethostbyname.
+//
+//  @param ipaddr   Pointer to an `ip_addr_t` written by resolve_hostname()
+//
+//  @return         `true` if resolution failed
+//
+bool ipaddr_is_failed(const ip_addr_t* ipaddr);
+
+// Free TCP + TLS protocol control block
+//
+//  Memory allocated for a protocol control block (with altcp_tls_new) needs to
+//  be freed (with altcp_close). Should closing fail (e.g. out of memory), the
+//  connection is aborted instead, which always frees the PCB.
+//
+//  N.b. only for PCBs with no error callback registered (abort would fire
+//  callback_altcp_err). disconnect_from_host detaches it beforehand.
+//
+//  @param pcb      Pointer to a `altcp_pcb` structure to be freed
+//
+void altcp_free_pcb(struct altcp_pcb* pcb);
+
+// Free TCP + TLS connection configuration
+//
+//  Memory allocated for TCP + TLS connection configuration (with
+//  altcp_tls_create_config_client) needs to be freed (with
+//  altcp_tls_free_config).
+//
+//  @param config   Pointer to a `altcp_tls_config` structure to be freed
+//
+void altcp_free_config(struct altcp_tls_config* config);
+
+// Free TCP + TLS connection callback argument
+//
+//  The common argument passed to lwIP connection callbacks must remain in
+//  scope for the duration of all callback contexts (i.e. connection lifetime).
+//  As such, it cannot be declared with function scope when registering the
+//  callback, but rather should be allocated on the heap. This implies the
+//  allocated memory must be freed on connection close.
+//
+//  @param arg      Pointer to a `altcp_callback_arg` structure to be freed
+//
+void altcp_free_arg(struct altcp_callback_arg* arg);
+
+// Establish TCP + TLS connection with server
+//
+//  Attempts to each resolved address are raced (Happy Eyeballs; RFC 8305),
+//  in order of preference, each started once the previous fails or after the
+//  connection attempt delay (PICOHTTPS_CONNECTION_ATTEMPT_DELAY). No further
+//  attempts are started once one has established its TCP connection, unless
+//  its TLS handshake then fails. The first to complete its TLS handshake is
+//  kept; the others are cancelled.
+//
+//  @param ipaddrs  Array of PICOHTTPS_ADDRESS_FAMILIES `ip_addr_t`
+//                  containing the server's IP addresses (see
+//                  resolve_hostname), in order of preference
+//  @param pcb      Double pointer to a `altcp_pcb` structure where the
+//                  protocol control block for the established connection
+//                  should be stored.
+//  @param deadline Time by which TCP + TLS handshake must complete
+//
+//  @return         `true` on success. On failure (incl. timeout) all
+//                  resources have been freed.
+//
+bool connect_to_host(
+    const ip_addr_t* ipaddrs,
+    struct altcp_pcb** pcb,
+    absolute_time_t deadline
+);
+
+// Start TCP + TLS connection attempt
+//
+//  Instantiate connection and send connection request (SYN); does not await
+//  the handshake. Establishment is signalled by the connection state.
+//
+//  @param ipaddr   Pointer to an `ip_addr_t` containing the server's IP
+//                  address
+//  @param hostname Server hostname, for Server Name Indication and
+//                  certificate verification
+//  @param port     Server port
+//  @param connection
+//                  Double pointer to a `altcp_callback_arg` structure where
+//                  the connection (lifecycle object) should be stored; to be
+//                  released with cancel_connection() or
+//                  disconnect_from_host()
+//
+//  @return         `true` on success. On failure all resources have been
+//                  freed.
+//
+bool connect_attempt(
+    const ip_addr_t* ipaddr,
+    const char* hostname,
+    u16_t port,
+    struct altcp_callback_arg** connection
+);
+
+// Disconnect TCP + TLS connection with server
+//
+//  Close connection (unless already aborted) and free all associated
+//  resources (PCB, configuration and callback argument).
+//
+//  @param arg      Pointer to the connection's `altcp_callback_arg` structure
+//
+void disconnect_from_host(struct altcp_callback_arg* arg);
+
+// Cancel TCP + TLS connection with server
+//
+//  Abort connection (unless already aborted), discarding any data in flight,
+//  and free all associated resources (PCB, configuration and callback
+//  argument). Each is freed exactly once, regardless of whether the
+//  connection was concurrently aborted by lwIP.
+//
+//  @param arg      Pointer to the connection's `altcp_callback_arg` structure
+//
+void cancel_connection(struct altcp_callback_arg* arg);
+
+// Verify pinned server public key
+//
+//  @param crt      Pointer to a `mbedtls_x509_crt` structure containing the
+//                  server (leaf) certificate
+//
+//  @return         `true` if the certificate public key is pinned (see
+//                  PICOHTTPS_PINNED_KEYS) and pins have not expired
+//
+bool verify_pinned_key(const mbedtls_x509_crt* crt);
+
+// Verify server certificate chain
+//
+//  Full validation of server certificate chain against
+//  PICOHTTPS_CA_ROOT_CERT, or PICOHTTPS_CA_BUNDLE (and PICOHTTPS_HOSTNAME).
+//
+//  @param chain    Pointer to a `mbedtls_x509_crt` structure containing the
+//                  server certificate chain
+//
+//  @return         `true` on success
+//
+bool verify_chain(mbedtls_x509_crt* chain);
+
+// Hash certificate name
+//
+//  FNV-1a (32-bit). Must match ca_bundle.py.
+//
+//  @param name     Pointer to DER-encoded name (tag and length included)
+//  @param len      Length of name
+//
+//  @return         Hash
+//
+u32_t ca_bundle_hash(const u8_t* name, size_t len);
+
+// Validate TCP + TLS connection state transition
 //
-//  Interval with which to poll for responses to DNS queries.
+//  @param from     Current connection state
+//  @param to       Next connection state
 //
-#define PICOHTTPS_RESOLVE_POLL_INTERVAL             100             // ms
+//  @return         `true` if transition is permitted (see `connection_state`)
+//
+bool connection_transition_valid(
+    enum connection_state from,
+    enum connection_state to
+);
 
-// Certificate authority root certificate
+// Set TCP + TLS connection state
 //
-//  CA certificate used to sign the HTTP server's certificate. DER or PEM
-//  formats (char array representation).
+//  Asserts (debug builds) validity of transition; catches double release and
+//  use after release of a connection. Must be called with lwIP lock held (or
+//  from a callback).
 //
-//  This is most readily obtained via inspection of the server's certificate
-//  chain, e.g. in a browser.
+//  @param arg      Pointer to the connection's `altcp_callback_arg` structure
+//  @param state    Next connection state
 //
-#define PICOHTTPS_CA_ROOT_CERT                          \
-{                                                       \
-    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,     \
-    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f      \
-}
+void connection_set_state(
+    struct altcp_callback_arg* arg,
+    enum connection_state state
+);
+
+// Check TCP + TLS connection liveness
 //
-//  or
+//  N.b. takes the connection callback argument rather than PCB, as the latter
+//  is freed by lwIP on abort.
 //
-//#define PICOHTTPS_CA_ROOT_CERT                                       \
-//"-----BEGIN CERTIFICATE-----\n"                                      \
-//"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/\n" \
-//"-----END CERTIFICATE-----\n"
+//  @param arg      Pointer to the connection's `altcp_callback_arg` structure
+//
+//  @return         `true` if the connection is established and has not been
+//                  aborted (reset, keepalive failure, or eviction by
+//                  callback_altcp_poll) or closed
+//
+bool connection_is_alive(const struct altcp_callback_arg* arg);
 
-// TCP + TLS connection establishment polling interval
+// Check TCP connection establishment
 //
-//  Interval with which to poll for establishment of TCP + TLS connection
+//  @param arg      Pointer to the connection's `altcp_callback_arg` structure
 //
-#define PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL       100             // ms
+//  @return         `true` if connecting, with the TCP handshake complete (TLS
+//                  handshake in progress)
+//
+bool connection_is_established(const struct altcp_callback_arg* arg);
 
-// TCP + TLS idle connection polling interval
+// Send HTTP request
 //
-//  Interval with which to poll application (i.e. call registered polling
-//  callback function) when TCP + TLS connection is idle.
+//  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
+//                  connection PCB to the server.
+//  @param deadline Time by which request must be acknowledged
 //
-//  The callback function should be registered with altcp_poll(). The polling
-//  interval is given in units of 'coarse grain timer shots'; one shot
-//  corresponds to approximately 500 ms.
+//  @return         `true` on success
 //
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+bool send_request(struct altcp_pcb* pcb, absolute_time_t deadline);
+
+// Send data
 //
-#define PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL          2               // shots
+//  Write data to the TCP + TLS send buffer, output it, and await its
+//  acknowledgement by the server.
+//
+//  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
+//                  connection PCB to the server.
+//  @param data     Pointer to the data to be sent
+//  @param len      Length of data to be sent
+//  @param deadline Time by which data must be acknowledged
+//
+//  @return         `true` on success
+//
+bool send_data(
+    struct altcp_pcb* pcb,
+    const void* data,
+    u16_t len,
+    absolute_time_t deadline
+);
 
-// HTTP request
+// Initialise HTTP request batch
 //
-//  Plain-text HTTP request to send to server
+//  @param batch    Pointer to a `request_batch` structure to be initialised
 //
-#define PICOHTTPS_REQUEST                   \
-    "GET / HTTP/1.1\r\n"                    \
-    "Host: " PICOHTTPS_HOSTNAME "\r\n"      \
-    "\r\n"
+void batch_init(struct request_batch* batch);
 
+// Queue HTTP request in batch
+//
+//  @param batch    Pointer to a `request_batch` structure
+//  @param request  Pointer to plain-text HTTP request to be queued
+//  @param len      Length of request
+//
+//  @return         `true` on success, `false` if batch buffer is full
+//
+bool batch_enqueue(
+    struct request_batch* batch,
+    const char* request,
+    u16_t len
+);
 
-// HTTP response polling interval
+// Check whether HTTP request batch is due
 //
-//  Interval with which to poll for HTTP response from server.
+//  @param batch    Pointer to a `request_batch` structure
 //
-#define PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL       100             // ms
+//  @return         `true` if batch is non-empty and either full or its oldest
+//                  request has been queued for PICOHTTPS_BATCH_MAX_DELAY
+//
+bool batch_due(const struct request_batch* batch);
 
-// Mbed TLS debug levels
+// Queue templated HTTP request in batch
 //
-//  Seemingly not defined in Mbed TLS‽
+//  Request is rendered (see template_render) directly into the batch buffer,
+//  with no intermediate formatting.
 //
-//  https://github.com/Mbed-TLS/mbedtls/blob/62e79dc913325a18b46aaea554a2836a4e6fc94b/include/mbedtls/debug.h#L141
+//  @param batch    Pointer to a `request_batch` structure
+//  @param segments Pointer to array of static template segments
+//  @param count    Number of static template segments
+//  @param holes    Pointer to array of `count - 1` dynamic segments
 //
-#define PICOHTTPS_MBEDTLS_DEBUG_LEVEL               3
+//  @return         `true` on success, `false` if batch has insufficient space
+//
+bool batch_enqueue_template(
+    struct request_batch* batch,
+    const struct request_segment* segments,
+    size_t count,
+    const struct request_segment* holes
+);
 
+// Render templated HTTP request
+//
+//  Gather static segments and dynamic holes (alternately) into a buffer.
+//
+//  @param buf      Pointer to buffer into which request is rendered
+//  @param size     Size of buffer
+//  @param segments Pointer to array of static template segments
+//  @param count    Number of static template segments
+//  @param holes    Pointer to array of `count - 1` dynamic segments
+//
+//  @return         Length of rendered request, or zero if buffer too small
+//
+size_t template_render(
+    char* buf,
+    size_t size,
+    const struct request_segment* segments,
+    size_t count,
+    const struct request_segment* holes
+);
 
-/* Macros *********************************************************************/
+// Format unsigned integer template hole
+//
+//  E.g. for Content-Length value.
+//
+//  @param buf      Pointer to buffer of at least 10 characters, into which
+//                  value is formatted (decimal, not null-terminated)
+//  @param value    Value to be formatted
+//
+//  @return         Segment referencing formatted value in `buf`
+//
+struct request_segment template_u32(char* buf, u32_t value);
 
-// Array length
-#define LEN(array) (sizeof array)/(sizeof array[0])
+// Initialise CBOR encoder
+//
+//  @param writer   Pointer to a `cbor_writer` structure to be initialised
+//  @param buf      Pointer to output buffer
+//  @param size     Size of output buffer
+//
+void cbor_init(struct cbor_writer* writer, u8_t* buf, size_t size);
 
+// Encode CBOR data item head
+//
+//  Major type and argument, in the shortest form.
+//
+//  @param writer   Pointer to a `cbor_writer` structure
+//  @param major    Major type (0–7)
+//  @param value    Argument (value, length or count, per major type)
+//
+void cbor_head(struct cbor_writer* writer, u8_t major, u32_t value);
 
+// Encode CBOR unsigned integer
+//
+//  @param writer   Pointer to a `cbor_writer` structure
+//  @param value    Value to be encoded
+//
+void cbor_uint(struct cbor_writer* writer, u32_t value);
 
-/* Data structures ************************************************************/
+// Encode CBOR text string
+//
+//  @param writer   Pointer to a `cbor_writer` structure
+//  @param text     Null-terminated (UTF-8) string to be encoded
+//
+void cbor_text(struct cbor_writer* writer, const char* text);
 
-// lwIP errors
+// Encode CBOR array head
 //
-//  typedef here to make source of error code more explicit
+//  To be followed by `count` items.
 //
-typedef err_t lwip_err_t;
+//  @param writer   Pointer to a `cbor_writer` structure
+//  @param count    Number of array items
+//
+void cbor_array(struct cbor_writer* writer, u32_t count);
 
-// Mbed TLS errors
+// Encode CBOR single-precision float
 //
-//  typedef here to make source of error code more explicit
+//  Encoded bitwise, with no formatting (cf. printf) of the value.
 //
-typedef int mbedtls_err_t;
+//  @param writer   Pointer to a `cbor_writer` structure
+//  @param value    Value to be encoded
+//
+void cbor_float(struct cbor_writer* writer, float value);
 
-// TCP connection callback argument
+// Queue telemetry POST in batch
 //
-//  All callbacks associated with lwIP TCP (+ TLS) connections can be passed a
-//  common argument. This is intended to allow application state to be accessed
-//  from within the callback context. The argument should be registered with
-//  altcp_arg().
+//  Encode records as a CBOR array (of `telemetry_record` arrays) and queue as
+//  a POST to PICOHTTPS_TELEMETRY_PATH (see PICOHTTPS_TELEMETRY_TEMPLATE).
 //
-//  The following structure is used for this argument in order to supply all
-//  the relevant application state required by the various callbacks.
+//  @param batch    Pointer to a `request_batch` structure
+//  @param records  Pointer to array of `telemetry_record` structures
+//  @param count    Number of records
 //
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+//  @return         `true` on success, `false` if encoded records exceed
+//                  PICOHTTPS_TELEMETRY_BUFFER_SIZE or batch has insufficient
+//                  space
 //
-struct altcp_callback_arg{
-
-    // TCP + TLS connection configurtaion
-    //
-    //  Memory allocated to the connection configuration structure needs to be
-    //  freed (with altcp_tls_free_config) in the connection error callback
-    //  (callback_altcp_err).
-    //
-    //  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-    //  https://www.nongnu.org/lwip/2_1_x/group__altcp__tls.html
-    //
-    struct altcp_tls_config* config;
+bool telemetry_enqueue(
+    struct request_batch* batch,
+    const struct telemetry_record* records,
+    size_t count
+);
 
-    // TCP + TLS connection state
-    //
-    //  Successful establishment of a connection needs to be signaled to the
-    //  application from the connection connect callback
-    //  (callback_altcp_connect).
-    //
-    //  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-    //
-    bool connected;
+// Send HTTP request batch
+//
+//  Send all queued requests in a single burst. Batch is retained (for retry)
+//  until emptied by the caller with batch_init().
+//
+//  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
+//                  connection PCB to the server.
+//  @param batch    Pointer to a `request_batch` structure
+//  @param deadline Time by which batch must be acknowledged
+//
+//  @return         `true` on success
+//
+bool send_batch(
+    struct altcp_pcb* pcb,
+    struct request_batch* batch,
+    absolute_time_t deadline
+);
 
-    // Data reception acknowledgement
-    //
-    //  The amount of data acknowledged as received by the server needs to be
-    //  communicated to the application from the connection sent callback
-    //  (callback_altcp_sent) for validatation of successful transmission.
-    //
-    u16_t acknowledged;
+// Attach output sink to connection
+//
+//  Subsequently, sink_drain() advertises receive window on the connection as
+//  space is freed. Must be detached (`arg` == `NULL`) before the connection
+//  is freed.
+//
+//  @param sink     Pointer to an `output_sink` structure
+//  @param arg      Pointer to the connection's `altcp_callback_arg`
+//                  structure, or `NULL` to detach
+//
+void sink_attach(struct output_sink* sink, struct altcp_callback_arg* arg);
 
-};
+// Acknowledge received data to TCP
+//
+//  Advertise receive window for data received over a connection and written
+//  to the output sink, subject to flow control (PICOHTTPS_RECV_FLOW_CONTROL).
+//  Must only be called with lwIP lock held (or from callbacks).
+//
+//  @param sink     Pointer to an `output_sink` structure
+//  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
+//                  connection PCB to the server.
+//  @param len      Number of bytes received
+//
+void sink_recved(struct output_sink* sink, struct altcp_pcb* pcb, u16_t len);
 
+// Write packet buffer chain to output sink
+//
+//  Copy (in bulk) as much of the packet buffer chain as fits in the sink. With
+//  PICOHTTPS_SINK_OVERFLOW_DROP, any remainder is dropped; otherwise, nothing
+//  is copied unless the whole chain fits.
+//
+//  @param sink     Pointer to an `output_sink` structure
+//  @param buf      Pointer to a `pbuf` structure at the head of the chain
+//
+//  @return         `true` if the chain was consumed (copied, or with
+//                  PICOHTTPS_SINK_OVERFLOW_DROP partly or wholly dropped) and
+//                  may be freed; `false` if refused (to be redelivered)
+//
+bool sink_write(struct output_sink* sink, const struct pbuf* buf);
 
+// Drain output sink
+//
+//  Write all buffered data to stdout (one fwrite() per contiguous span), then
+//  advertise any withheld receive window once below the low watermark.
+//  Should be called from the main loop, not from lwIP callback context.
+//
+//  @param sink     Pointer to an `output_sink` structure
+//
+//  @return         Number of bytes drained
+//
+size_t sink_drain(struct output_sink* sink);
 
-/* Functions ******************************************************************/
+// Write log record
+//
+//  Copy record (header, arguments, text) into the log buffer; formatting is
+//  deferred to log_drain(). Must only be called with lwIP lock held (or from
+//  callbacks). Generally used through PICOHTTPS_LOG(), which filters by level
+//  at compile time.
+//
+//  @param module   Module (`enum log_module`)
+//  @param level    Level
+//  @param format   Format (`enum log_format`)
+//  @param args     Pointer to arguments
+//  @param argc     Number of arguments; at most PICOHTTPS_LOG_ARGS
+//  @param text     Pointer to text, or `NULL`
+//  @param len      Length of text; truncated to PICOHTTPS_LOG_TEXT_SIZE
+//
+//  @return         `true` on success, `false` if dropped (buffer full)
+//
+bool log_write(
+    u8_t module,
+    u8_t level,
+    u16_t format,
+    const u32_t* args,
+    size_t argc,
+    const char* text,
+    size_t len
+);
 
-// Initialise standard I/O over USB
+// Drain log buffer
 //
-//  @return         `true` on success
+//  Decode all buffered records and write them to stdout, one line per record.
+//  Each record is copied out and its space released before formatting.
+//  Should be called from the main loop, not from lwIP callback context.
 //
-bool init_stdio(void);
+//  @return         Number of records drained
+//
+size_t log_drain(void);
 
-// Initialise Pico W wireless hardware
+#ifdef PICOHTTPS_RECV_TRACE_SIZE
+// Record received data in receive trace
 //
-//  @return         `true` on success
+//  Appends data, and its segmentation, of a packet buffer chain delivered to
+//  callback_altcp_recv. Once a chain does not fit, the trace is full and
+//  recording stops. Must only be called from lwIP callback context.
 //
-bool init_cyw43(void);
+//  @param trace    Pointer to a `recv_trace` structure
+//  @param buf      Pointer to a `pbuf` structure at the head of the chain
+//
+void recv_trace_record(struct recv_trace* trace, const struct pbuf* buf);
 
-// Connect to wireless network
+// Print receive trace
 //
-//  @return         `true` on success
+//  Between "recv_trace begin" and "recv_trace end" marker lines, one line per
+//  callback, with each packet buffer as a hexadecimal string (space
+//  separated). Input to recv_trace.py.
 //
-bool connect_to_network(void);
+//  @param trace    Pointer to a `recv_trace` structure
+//
+void recv_trace_print(const struct recv_trace* trace);
+#endif //PICOHTTPS_RECV_TRACE_SIZE
 
-// Resolve hostname
+// Run receive benchmark
 //
-//  @param ipaddr   Pointer to an `ip_addr_t` where the resolved IP address
-//                  should be stored.
+//  Replay trace (PICOHTTPS_RECV_BENCHMARK) with recorded segmentation, then
+//  fuzzed (PICOHTTPS_RECV_BENCHMARK_FUZZ times), and print results. Must be
+//  called before any request is queued or connection is made; resets the
+//  output sink.
 //
-//  @return         `true` on success
+//  @return         `true` if parsing results of all fuzzed replays match the
+//                  recorded replay
 //
-bool resolve_hostname(ip_addr_t* ipaddr);
+bool recv_benchmark(void);
 
-// Free TCP + TLS protocol control block
+// Replay receive trace
 //
-//  Memory allocated for a protocol control block (with altcp_tls_new) needs to
-//  be freed (with altcp_close).
+//  Through the receive path of callback_altcp_recv (output sink, response
+//  parser); output is discarded. Each callback is timed.
 //
-//  @param pcb      Pointer to a `altcp_pcb` structure to be freed
+//  @param seed     Seed for pseudo-random segmentation, or 0 for recorded
+//                  segmentation
+//  @param result   Pointer to a `recv_benchmark_result` structure where the
+//                  result should be stored
 //
-void altcp_free_pcb(struct altcp_pcb* pcb);
+void recv_benchmark_replay(u32_t seed, struct recv_benchmark_result* result);
 
-// Free TCP + TLS connection configuration
+// Generate pseudo-random number
 //
-//  Memory allocated for TCP + TLS connection configuration (with
-//  altcp_tls_create_config_client) needs to be freed (with
-//  altcp_tls_free_config).
+//  xorshift32; reproducible for a given seed, unlike get_rand_32().
 //
-//  @param config   Pointer to a `altcp_tls_config` structure to be freed
+//  @param state    Pointer to (non-zero) generator state
 //
-void altcp_free_config(struct altcp_tls_config* config);
+//  @return         Pseudo-random number
+//
+u32_t recv_benchmark_rand(u32_t* state);
 
-// Free TCP + TLS connection callback argument
+// Snapshot runtime statistics
 //
-//  The common argument passed to lwIP connection callbacks must remain in
-//  scope for the duration of all callback contexts (i.e. connection lifetime).
-//  As such, it cannot be declared with function scope when registering the
-//  callback, but rather should be allocated on the heap. This implies the
-//  allocated memory must be freed on connection close.
+//  @param stats    Pointer to a `picohttps_stats` structure where the snapshot
+//                  should be stored.
 //
-//  @param arg      Pointer to a `altcp_callback_arg` structure to be freed
+void stats_snapshot(struct picohttps_stats* stats);
+
+// Serialize runtime statistics
 //
-void altcp_free_arg(struct altcp_callback_arg* arg);
+//  Serialize runtime statistics snapshot as compact JSON.
+//
+//  @param stats    Pointer to a `picohttps_stats` structure containing the
+//                  snapshot to be serialized
+//  @param buf      Buffer where the null-terminated serialization should be
+//                  stored
+//  @param len      Size of buffer
+//
+//  @return         Length of serialization (excluding null terminator), or
+//                  zero if the buffer is too small
+//
+size_t stats_serialize(
+    const struct picohttps_stats* stats,
+    char* buf,
+    size_t len
+);
 
-// Establish TCP + TLS connection with server
+// Print runtime statistics
 //
-//  @param ipaddr   Pointer to an `ip_addr_t` containing the server's IP
-//                  address
-//  @param pcb      Double pointer to a `altcp_pcb` structure where the
-//                  protocol control block for the established connection
-//                  should be stored.
+//  Snapshot, serialize and print runtime statistics to stdout.
 //
 //  @return         `true` on success
 //
-bool connect_to_host(ip_addr_t* ipaddr, struct altcp_pcb** pcb);
+bool stats_print(void);
 
-// Send HTTP request
+// Check whether runtime statistics upload is due
+//
+//  @return         `true` if PICOHTTPS_STATS_UPLOAD_INTERVAL has elapsed
+//                  since the previous upload (or no upload has yet been made)
+//
+bool stats_upload_due(void);
+
+// Upload runtime statistics
+//
+//  Snapshot and serialize runtime statistics, then POST to
+//  PICOHTTPS_STATS_UPLOAD_PATH on server.
 //
 //  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
 //                  connection PCB to the server.
+//  @param deadline Time by which upload must be acknowledged
 //
 //  @return         `true` on success
 //
-bool send_request(struct altcp_pcb* pcb);
+bool stats_upload(struct altcp_pcb* pcb, absolute_time_t deadline);
+
+// Mbed TLS heap allocation (tracked)
+//
+//  Drop-in replacement for calloc() which maintains Mbed TLS heap usage
+//  statistics. Installed with mbedtls_platform_set_calloc_free().
+//
+//  https://github.com/Mbed-TLS/mbedtls/blob/mbedtls-2.28/include/mbedtls/platform.h
+//
+void* stats_mbedtls_calloc(size_t n, size_t size);
+
+// Mbed TLS heap deallocation (tracked)
+//
+//  Drop-in replacement for free() which maintains Mbed TLS heap usage
+//  statistics. Installed with mbedtls_platform_set_calloc_free().
+//
+void stats_mbedtls_free(void* ptr);
 
 // DNS response callback
 //
@@ -281,6 +3336,27 @@ void callback_gethostbyname(
     void* ipaddr
 );
 
+// Network interface link callback
+//
+//  Callback function fired on wireless link state change.
+//
+//  Registered with netif_set_link_callback().
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__netif.html
+//
+void callback_netif_link(struct netif* netif);
+
+// Network interface status callback
+//
+//  Callback function fired on network interface state (up/down, address)
+//  change.
+//
+//  Registered with netif_set_status_callback().
+//
+//  https://www.nongnu.org/lwip/2_1_x/group__netif.html
+//
+void callback_netif_status(struct netif* netif);
+
 // TCP + TLS connection error callback
 //
 //  Callback function fired on TCP + TLS connection fatal error.
@@ -293,9 +3369,13 @@ void callback_altcp_err(void* arg, lwip_err_t err);
 
 // TCP + TLS connection idle callback
 //
-//  Callback function fired on idle TCP + TLS connection.
+//  Callback function fired periodically (every
+//  PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL) on TCP + TLS connection. Evicts
+//  (aborts) connections which have been idle for longer than
+//  PICOHTTPS_ALTCP_IDLE_TIMEOUT, or whose request in flight has passed its
+//  deadline.
 //
-//  Registered with altcp_err().
+//  Registered with altcp_poll().
 //
 //  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
 //
@@ -342,6 +3422,73 @@ lwip_err_t callback_altcp_connect(
     lwip_err_t err
 );
 
+// Trusted CA callback
+//
+//  Callback function fired during certificate chain validation, for the CAs
+//  which may have issued a certificate. Looks up the certificate's issuer in
+//  the CA bundle index (PICOHTTPS_CA_BUNDLE), and parses matching CA
+//  certificates in place (from flash). Candidates are allocated here and
+//  freed by Mbed TLS.
+//
+//  Registered with mbedtls_ssl_conf_ca_cb().
+//
+//  https://github.com/Mbed-TLS/mbedtls/blob/v2.28.2/include/mbedtls/x509_crt.h
+//
+int callback_ca_bundle(
+    void* arg,
+    const mbedtls_x509_crt* child,
+    mbedtls_x509_crt** candidates
+);
+
+// Event stream event callback
+//
+//  Callback function fired on each event received from the event stream
+//  (lwIP callback context). Example only; applications would dispatch
+//  commands here.
+//
+//  Registered with stream_start().
+//
+void callback_stream_event(const char* type, const char* data, u16_t len);
+
+// WebSocket message callback
+//
+//  Callback function fired on each message received over the WebSocket
+//  (lwIP callback context). Example only.
+//
+//  Registered with websocket_start().
+//
+void callback_websocket_message(u8_t opcode, const u8_t* data, u16_t len);
+
+// Random number generation callback
+//
+//  Callback function fired whenever Mbed TLS requires random bytes (lwIP
+//  callback context, incl. the TLS handshake). Served from the random byte
+//  pool, else (remainder) from the DRBG.
+//
+//  Registered with mbedtls_ssl_conf_rng().
+//
+//  https://github.com/Mbed-TLS/mbedtls/blob/mbedtls-2.28/include/mbedtls/ssl.h
+//
+int callback_rng(void* arg, unsigned char* output, size_t len);
+
+// Mbed TLS debug callback
+//
+//  Callback function fired on each Mbed TLS debug message (lwIP callback
+//  context, incl. the TLS handshake). Writes the message to the log buffer
+//  rather than printing it synchronously.
+//
+//  Registered with mbedtls_ssl_conf_dbg(). Only with MBEDTLS_DEBUG_C.
+//
+//  https://github.com/Mbed-TLS/mbedtls/blob/mbedtls-2.28/include/mbedtls/ssl.h
+//
+void callback_mbedtls_debug(
+    void* arg,
+    int level,
+    const char* file,
+    int line,
+    const char* str
+);
+
 
 
 #endif //PICOHTTPS_H
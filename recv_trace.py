@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+
+# Receive trace converter for Pico HTTPS example ###############################
+#                                                                              #
+#   Extracts a receive trace (PICOHTTPS_RECV_TRACE_SIZE) from captured stdio   #
+#   output and converts it into a C header defining the received data, and     #
+#   its segmentation into callbacks and packet buffers, for replay by the      #
+#   receive benchmark; see PICOHTTPS_RECV_BENCHMARK.                           #
+#                                                                              #
+#   Usage: recv_trace.py <stdio.log> <recv_trace.h>                            #
+#                                                                              #
+################################################################################
+
+import sys
+
+
+# Parse trace
+#
+#   One line per callback between marker lines, with each packet buffer as a
+#   hexadecimal string (space separated). Other output is ignored; the last
+#   trace in the log is used.
+#
+chains = None
+tracing = False
+for line in open(sys.argv[1], errors="replace"):
+    line = line.strip()
+    if line == "recv_trace begin":
+        chains = []
+        tracing = True
+    elif line == "recv_trace end":
+        tracing = False
+    elif tracing:
+        chains.append([bytes.fromhex(segment) for segment in line.split(" ")])
+if not chains:
+    sys.exit("No receive trace in " + sys.argv[1])
+if tracing:
+    sys.exit("Truncated receive trace in " + sys.argv[1])
+
+# Flatten
+data = b"".join(segment for chain in chains for segment in chain)
+segments = [len(segment) for chain in chains for segment in chain]
+counts = [len(chain) for chain in chains]
+
+
+# Array initialiser
+#
+#   Sixteen values per line.
+#
+def initialiser(name, values, format):
+    lines = [
+        "    " + ", ".join(format % value for value in values[i:i + 16]) + ", \\\n"
+        for i in range(0, len(values), 16)
+    ]
+    return "#define " + name + " \\\n{ \\\n" + "".join(lines) + "}\n"
+
+
+# Write header
+with open(sys.argv[2], "w") as header:
+    header.write(
+        "// Generated by recv_trace.py from " + sys.argv[1] + "; do not edit\n"
+        "//\n"
+        "// " + str(len(data)) + " bytes, " + str(len(counts)) + " callbacks, "
+        + str(len(segments)) + " packet buffers\n"
+        "\n"
+        + initialiser("PICOHTTPS_RECV_TRACE_DATA", data, "0x%02x") + "\n"
+        + initialiser("PICOHTTPS_RECV_TRACE_LENGTHS", segments, "%u") + "\n"
+        + initialiser("PICOHTTPS_RECV_TRACE_CHAINS", counts, "%u") + "\n"
+        "#define PICOHTTPS_RECV_TRACE_CHAIN_MAX " + str(max(counts)) + "\n"
+    )